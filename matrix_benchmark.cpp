@@ -0,0 +1,464 @@
+// Benchmarks for the Matrix operations in matrix_solver_test.cpp
+//
+// Build and run next to the calculator:
+//
+//   g++ -std=c++17 -O2 -pthread matrix_benchmark.cpp -o matrix_benchmark
+//   ./matrix_benchmark [--quick] [--threads N] [--repeats N] [--filter TEXT] > results.json
+//
+// Every case runs on matrices filled from a fixed seed, so two runs on the
+// same machine time exactly the same work. Each case is warmed up once, then
+// timed --repeats times; a sample repeats the operation until it has run for
+// at least kMinSampleSeconds. The JSON on stdout reports, per operation:
+// median and best seconds, GFLOP/s where the flop count is well defined,
+// bytes/s of matrix data moved (of text, for parse and print), and heap
+// allocations and bytes per operation.
+// Progress goes to stderr. The tiled cases keep their files in $TMPDIR
+// (default /tmp) and remove them at the end.
+#define MATRIX_NO_MAIN
+#include "matrix_solver_test.cpp"
+
+#include <chrono>
+#include <random>
+
+// Allocation counting
+//
+// Every heap allocation in the process goes through these replacements; the
+// benchmark reads the counters before and after each timed sample.
+namespace alloccount {
+std::atomic<size_t> count(0);
+std::atomic<size_t> bytes(0);
+
+void* allocate(size_t size, size_t alignment) {
+    count.fetch_add(1, std::memory_order_relaxed);
+    bytes.fetch_add(size, std::memory_order_relaxed);
+    void* p = nullptr;
+    if (alignment <= alignof(std::max_align_t)) {
+        p = std::malloc(size == 0 ? 1 : size);
+    } else {
+        size_t rounded = (size + alignment - 1) / alignment * alignment;
+        p = std::aligned_alloc(alignment, rounded == 0 ? alignment : rounded);
+    }
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+} // namespace alloccount
+
+void* operator new(size_t size) { return alloccount::allocate(size, 0); }
+void* operator new[](size_t size) { return alloccount::allocate(size, 0); }
+void* operator new(size_t size, std::align_val_t al) { return alloccount::allocate(size, static_cast<size_t>(al)); }
+void* operator new[](size_t size, std::align_val_t al) { return alloccount::allocate(size, static_cast<size_t>(al)); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { std::free(p); }
+
+namespace {
+
+const unsigned kSeed = 42;
+const double kMinSampleSeconds = 0.02;
+
+// Swallows output while counting how much was written
+class CountingBuffer : public std::streambuf {
+public:
+    size_t written = 0;
+
+protected:
+    int overflow(int c) override {
+        ++written;
+        return c;
+    }
+    std::streamsize xsputn(const char*, std::streamsize n) override {
+        written += static_cast<size_t>(n);
+        return n;
+    }
+};
+
+// Points std::cout at a CountingBuffer for as long as it lives
+class SilenceCout {
+public:
+    SilenceCout() : previous(std::cout.rdbuf(&buffer)) {}
+    ~SilenceCout() { std::cout.rdbuf(previous); }
+    size_t written() const { return buffer.written; }
+
+private:
+    CountingBuffer buffer;
+    std::streambuf* previous;
+};
+
+// Uniform values in [-1, 1]; a density below 1 leaves the rest zero
+Matrix randomMatrix(const std::string& name, size_t rows, size_t columns, double density, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> value(-1.0f, 1.0f);
+    std::uniform_real_distribution<double> keep(0.0, 1.0);
+    Matrix m(name, rows, columns);
+    FloatView v = m.view();
+    for (size_t r = 0; r < rows; ++r) {
+        for (size_t c = 0; c < columns; ++c) {
+            if (density >= 1.0 || keep(rng) < density) {
+                v(r, c) = value(rng);
+            }
+        }
+    }
+    return m;
+}
+
+// An n x (n + 1) augmented system with a unique solution: random entries with
+// a dominant diagonal
+Matrix randomSystem(size_t n, unsigned seed) {
+    Matrix m = randomMatrix("S", n, n + 1, 1.0, seed);
+    FloatView v = m.view();
+    for (size_t i = 0; i < n; ++i) {
+        v(i, i) += static_cast<float>(n);
+    }
+    return m;
+}
+
+// The n x (n + 1) system of a 1-D Poisson problem: tridiagonal, so fastSolve
+// takes the sparse path
+Matrix tridiagonalSystem(size_t n) {
+    Matrix m("T", n, n + 1);
+    FloatView v = m.view();
+    for (size_t i = 0; i < n; ++i) {
+        v(i, i) = 2.0f;
+        if (i > 0) {
+            v(i, i - 1) = -1.0f;
+        }
+        if (i + 1 < n) {
+            v(i, i + 1) = -1.0f;
+        }
+        v(i, n) = 1.0f;
+    }
+    return m;
+}
+
+// One row of text per matrix row, as a user would paste into createMatrix
+std::string matrixText(const Matrix& m) {
+    std::ostringstream text;
+    ConstFloatView v = m.view();
+    for (size_t r = 0; r < v.rows; ++r) {
+        for (size_t c = 0; c < v.columns; ++c) {
+            text << v(r, c) << (c + 1 < v.columns ? " " : "\n");
+        }
+    }
+    return text.str();
+}
+
+struct Case {
+    std::string operation;
+    std::string shape;
+    size_t rows;
+    size_t columns;
+    size_t inner;  // Shared dimension of a product, 0 otherwise
+    double flops;  // Per operation; 0 when not meaningful
+    double bytes;  // Matrix data read and written per operation
+    std::function<void()> setup; // Untimed, before every run (e.g. restore the input)
+    std::function<void()> run;
+    size_t batch = 0; // Matrices handled per operation by the batch cases
+};
+
+struct Result {
+    double medianSeconds = 0;
+    double bestSeconds = 0;
+    double allocations = 0;
+    double allocatedBytes = 0;
+    size_t iterations = 0;
+};
+
+Result measure(const Case& c, size_t repeats) {
+    using Clock = std::chrono::steady_clock;
+    auto runOnce = [&]() {
+        if (c.setup) {
+            c.setup();
+        }
+        Clock::time_point start = Clock::now();
+        c.run();
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    };
+
+    // Warm up and size the samples
+    double first = runOnce();
+    size_t iterations = std::max<size_t>(1, static_cast<size_t>(kMinSampleSeconds / std::max(first, 1e-9)));
+
+    Result result;
+    result.iterations = iterations;
+    std::vector<double> samples;
+    size_t allocations = 0, allocatedBytes = 0;
+    for (size_t rep = 0; rep < repeats; ++rep) {
+        double total = 0;
+        for (size_t i = 0; i < iterations; ++i) {
+            if (c.setup) {
+                c.setup();
+            }
+            size_t countBefore = alloccount::count.load();
+            size_t bytesBefore = alloccount::bytes.load();
+            Clock::time_point start = Clock::now();
+            c.run();
+            total += std::chrono::duration<double>(Clock::now() - start).count();
+            allocations += alloccount::count.load() - countBefore;
+            allocatedBytes += alloccount::bytes.load() - bytesBefore;
+        }
+        samples.push_back(total / static_cast<double>(iterations));
+    }
+    std::sort(samples.begin(), samples.end());
+    result.bestSeconds = samples.front();
+    result.medianSeconds = samples[samples.size() / 2];
+    double operations = static_cast<double>(repeats * iterations);
+    result.allocations = static_cast<double>(allocations) / operations;
+    result.allocatedBytes = static_cast<double>(allocatedBytes) / operations;
+    return result;
+}
+
+std::string jsonNumber(double value) {
+    if (!std::isfinite(value)) {
+        return "null";
+    }
+    std::ostringstream out;
+    out.precision(6);
+    out << value;
+    return out.str();
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    bool quick = false;
+    size_t repeats = 5;
+    std::string filter;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--quick") {
+            quick = true;
+        } else if (arg == "--threads" && i + 1 < argc) {
+            long count = std::strtol(argv[++i], nullptr, 10);
+            if (count <= 0) {
+                std::cerr << "Error: --threads expects a positive number.\n";
+                return 1;
+            }
+            ThreadPool::setThreadCount(static_cast<size_t>(count));
+        } else if (arg == "--repeats" && i + 1 < argc) {
+            long count = std::strtol(argv[++i], nullptr, 10);
+            if (count <= 0) {
+                std::cerr << "Error: --repeats expects a positive number.\n";
+                return 1;
+            }
+            repeats = static_cast<size_t>(count);
+        } else if (arg == "--filter" && i + 1 < argc) {
+            filter = argv[++i];
+        } else {
+            std::cerr << "Error: Unknown option " << arg << ".\n";
+            std::cerr << "Usage: " << argv[0] << " [--quick] [--threads N] [--repeats N] [--filter TEXT]\n";
+            return 1;
+        }
+    }
+    Matrix::setVerbosity(Verbosity::Silent);
+
+    struct Shape {
+        std::string name;
+        size_t rows, columns;
+        double density;
+    };
+    std::vector<Shape> shapes;
+    for (size_t n : quick ? std::vector<size_t>{64, 256} : std::vector<size_t>{64, 256, 1024}) {
+        shapes.push_back({"square", n, n, 1.0});
+    }
+    shapes.push_back({"tall-skinny", quick ? 2048u : 8192u, 64, 1.0});
+    shapes.push_back({"sparse-ish", quick ? 256u : 1024u, quick ? 256u : 1024u, 0.01});
+
+    std::vector<Case> cases;
+    // Deques keep addresses stable for the closures
+    std::deque<Matrix> inputs;
+    std::deque<Matrix> scratch;
+    std::deque<SparseMatrix> sparseInputs;
+    std::deque<std::string> texts;
+
+    for (const Shape& s : shapes) {
+        const size_t m = s.rows, n = s.columns;
+        const double elements = static_cast<double>(m) * static_cast<double>(n);
+        Matrix& a = inputs.emplace_back(randomMatrix("A", m, n, s.density, kSeed));
+        Matrix& b = inputs.emplace_back(randomMatrix("B", m, n, s.density, kSeed + 1));
+        // Products are A * A^T shaped, so tall-skinny gives an m x m result
+        // and the normal-equations form A^T * A comes out 64 x 64
+        Matrix& at = inputs.emplace_back(a.transpose());
+        Matrix& out = scratch.emplace_back();
+
+        cases.push_back({"multiply", s.name, m, m, n, 2.0 * m * m * n, 4.0 * (2.0 * elements + double(m) * m),
+                         nullptr, [&a, &at, &out] { out = a.multiply(at); }});
+        if (s.name == "tall-skinny") {
+            cases.push_back({"multiply", "normal-equations", n, n, m, 2.0 * n * n * m, 4.0 * (2.0 * elements + double(n) * n),
+                             nullptr, [&a, &at, &out] { out = at.multiply(a); }});
+        }
+        if (s.density < 1.0) {
+            SparseMatrix& sa = sparseInputs.emplace_back(SparseMatrix::fromDense(a));
+            SparseMatrix& sat = sparseInputs.emplace_back(sa.transpose());
+            double nnz = static_cast<double>(sa.nonZeros());
+            cases.push_back({"sparse-multiply", s.name, m, m, n, 2.0 * nnz * nnz / n, 8.0 * nnz * 2,
+                             nullptr, [&sa, &sat] { SparseMatrix product = sa.multiply(sat); }});
+        }
+        cases.push_back({"add", s.name, m, n, 0, elements, 12.0 * elements,
+                         nullptr, [&a, &b, &out] { out = a.add(b); }});
+        cases.push_back({"transpose", s.name, m, n, 0, 0, 8.0 * elements,
+                         nullptr, [&a, &out] { out = a.transpose(); }});
+        // Copy-on-write: duplicate moves no data until one side is written
+        cases.push_back({"duplicate", s.name, m, n, 0, 0, 0,
+                         nullptr, [&a, &out] { out = a.duplicate("D"); }});
+        size_t printed;
+        {
+            SilenceCout silence;
+            a.print(true);
+            printed = silence.written();
+        }
+        cases.push_back({"print", s.name, m, n, 0, 0, static_cast<double>(printed),
+                         nullptr, [&a] { SilenceCout silence; a.print(true); }});
+
+        // createMatrix reads rows from std::cin and prompts on std::cout
+        const std::string& text = texts.emplace_back(matrixText(a));
+        Matrix& parsed = scratch.emplace_back("P", m, n);
+        cases.push_back({"parse", s.name, m, n, 0, 0, static_cast<double>(text.size()),
+                         nullptr, [&text, &parsed] {
+                             std::istringstream in(text);
+                             std::streambuf* previous = std::cin.rdbuf(in.rdbuf());
+                             {
+                                 SilenceCout silence;
+                                 parsed.createMatrix();
+                             }
+                             std::cin.rdbuf(previous);
+                         }});
+    }
+
+    // Solvers work on n x (n + 1) systems and overwrite them, so each run
+    // starts from a fresh copy. duplicate only shares the data; taking a
+    // mutable view makes the copy before the timer starts.
+    for (size_t n : quick ? std::vector<size_t>{64, 128} : std::vector<size_t>{64, 256, 512}) {
+        const double gaussJordan = 2.0 * n * n * (n + 1);
+        const double elements = static_cast<double>(n) * (n + 1);
+        Matrix& system = inputs.emplace_back(randomSystem(n, kSeed + 2));
+        Matrix& work = scratch.emplace_back();
+        cases.push_back({"attemptSolution", "square", n, n + 1, 0, gaussJordan, 8.0 * elements,
+                         [&system, &work] { work = system.duplicate("S"); work.view(); },
+                         [&work] { work.attemptSolution(); }});
+        cases.push_back({"fastSolve", "square", n, n + 1, 0, gaussJordan, 8.0 * elements,
+                         [&system, &work] { work = system.duplicate("S"); work.view(); },
+                         [&work] { work.fastSolve(); }});
+    }
+    {
+        size_t n = quick ? 1000 : 4000;
+        Matrix& system = inputs.emplace_back(tridiagonalSystem(n));
+        Matrix& work = scratch.emplace_back();
+        cases.push_back({"fastSolve", "sparse-ish", n, n + 1, 0, 0, 4.0 * 3 * n,
+                         [&system, &work] { work = system.duplicate("S"); work.view(); },
+                         [&work] { work.fastSolve(); }});
+    }
+
+    // Many small matrices at once: the structure-of-arrays batch against
+    // factoring and solving each matrix on its own
+    const size_t batch = quick ? 1024 : 4096;
+    std::deque<MatrixBatch> batches;
+    std::deque<std::vector<Matrix>> systems;
+    for (size_t n : {3, 4, 8, 16}) {
+        const std::string shape = "batch-" + std::to_string(batch);
+        const double count = static_cast<double>(batch), size = static_cast<double>(n) * n;
+        MatrixBatch& a = batches.emplace_back(batch, n, n);
+        MatrixBatch& b = batches.emplace_back(batch, n, n);
+        MatrixBatch& rhs = batches.emplace_back(batch, n, 1);
+        std::vector<Matrix>& each = systems.emplace_back();
+        for (size_t i = 0; i < batch; ++i) {
+            Matrix system = randomSystem(n, kSeed + 3 + static_cast<unsigned>(i));
+            a.setMatrix(i, system.view().block(0, 0, n, n));
+            rhs.setMatrix(i, system.view().block(0, n, n, 1));
+            b.setMatrix(i, randomMatrix("B", n, n, 1.0, kSeed + 4 + static_cast<unsigned>(i)).view());
+            each.push_back(system);
+        }
+        MatrixBatch& out = batches.emplace_back();
+        cases.push_back({"batch-multiply", shape, n, n, n, 2.0 * count * size * n, 12.0 * count * size,
+                         nullptr, [&a, &b, &out] { out = a.multiply(b); }, batch});
+        cases.push_back({"batch-transpose", shape, n, n, 0, 0, 8.0 * count * size,
+                         nullptr, [&a, &out] { out = a.transpose(); }, batch});
+        const double luFlops = count * (2.0 * size * n / 3.0 + 2.0 * size);
+        cases.push_back({"batch-solve", shape, n, n + 1, 0, luFlops, 4.0 * count * (size + 2.0 * n),
+                         nullptr, [&a, &rhs, &out] { out = a.solve(rhs); }, batch});
+        cases.push_back({"lu-solve-each", shape, n, n + 1, 0, luFlops, 4.0 * count * (size + 2.0 * n),
+                         nullptr, [&each, n] {
+                             Matrix x("X", n, 1);
+                             for (const Matrix& system : each) {
+                                 LUFactorization lu(system.view().block(0, 0, n, n));
+                                 lu.solve(system.view().block(0, n, n, 1), x.view());
+                             }
+                         }, batch});
+    }
+
+    // Out-of-core: the same operations through tiled files, with a budget
+    // that holds only part of each operand, so multiply re-reads B and solve
+    // works in more than one panel
+    const char* tmpdir = std::getenv("TMPDIR");
+    const std::string tileDir = tmpdir && *tmpdir ? tmpdir : "/tmp";
+    std::deque<TiledMatrix> tiled;
+    {
+        const size_t n = quick ? 1024 : 2048, tile = 256;
+        TiledMatrix::setMemoryBudget(quick ? 4 : 16);
+        const double elements = static_cast<double>(n) * n;
+        Matrix system = randomSystem(n, kSeed + 5);
+        TiledMatrix& a = tiled.emplace_back(
+            TiledMatrix::fromMatrix(system.view().block(0, 0, n, n), tileDir + "/matrix_benchmark_a.mtxt", tile));
+        TiledMatrix& b = tiled.emplace_back(
+            TiledMatrix::fromMatrix(system.view().block(0, n, n, 1), tileDir + "/matrix_benchmark_b.mtxt", tile));
+        const std::string out = tileDir + "/matrix_benchmark_out.mtxt";
+        cases.push_back({"tiled-add", "square", n, n, 0, elements, 12.0 * elements,
+                         nullptr, [&a, out] { a.add(a, out); }});
+        cases.push_back({"tiled-transpose", "square", n, n, 0, 0, 8.0 * elements,
+                         nullptr, [&a, out] { a.transpose(out); }});
+        cases.push_back({"tiled-multiply", "square", n, n, n, 2.0 * elements * n, 0,
+                         nullptr, [&a, out] { a.multiply(a, out); }});
+        cases.push_back({"tiled-solve", "square", n, n + 1, 0, 2.0 * elements * n / 3.0, 0,
+                         nullptr, [&a, &b, out] { a.solve(b, out); }});
+    }
+
+    std::cout << "{\n";
+    std::cout << "  \"benchmark\": \"matrix_solver\",\n";
+    std::cout << "  \"threads\": " << ThreadPool::instance().size() << ",\n";
+    std::cout << "  \"simd\": \"" << gemm::microKernelName() << "\",\n";
+    std::cout << "  \"seed\": " << kSeed << ",\n";
+    std::cout << "  \"repeats\": " << repeats << ",\n";
+    std::cout << "  \"results\": [";
+    bool firstResult = true;
+    for (const Case& c : cases) {
+        std::string label = c.operation + "/" + c.shape + "/" + std::to_string(c.rows) + "x" + std::to_string(c.columns);
+        if (!filter.empty() && label.find(filter) == std::string::npos) {
+            continue;
+        }
+        std::cerr << label << "..." << std::endl;
+        Result r = measure(c, repeats);
+        std::cout << (firstResult ? "\n" : ",\n");
+        firstResult = false;
+        std::cout << "    {\"operation\": \"" << c.operation << "\", \"shape\": \"" << c.shape << "\""
+                  << ", \"rows\": " << c.rows << ", \"columns\": " << c.columns;
+        if (c.inner > 0) {
+            std::cout << ", \"inner\": " << c.inner;
+        }
+        if (c.batch > 0) {
+            std::cout << ", \"batch\": " << c.batch;
+        }
+        std::cout << ", \"iterations\": " << r.iterations
+                  << ", \"seconds_median\": " << jsonNumber(r.medianSeconds)
+                  << ", \"seconds_best\": " << jsonNumber(r.bestSeconds)
+                  << ", \"gflops\": " << (c.flops > 0 ? jsonNumber(c.flops / r.medianSeconds / 1e9) : "null")
+                  << ", \"bytes_per_second\": " << (c.bytes > 0 ? jsonNumber(c.bytes / r.medianSeconds) : "null");
+        if (c.batch > 0) {
+            std::cout << ", \"matrices_per_second\": " << jsonNumber(c.batch / r.medianSeconds);
+        }
+        std::cout
+                  << ", \"allocations\": " << jsonNumber(r.allocations)
+                  << ", \"allocated_bytes\": " << jsonNumber(r.allocatedBytes) << "}";
+    }
+    std::cout << "\n  ]\n}\n";
+    for (const TiledMatrix& m : tiled) {
+        std::remove(m.path().c_str());
+    }
+    std::remove((tileDir + "/matrix_benchmark_out.mtxt").c_str());
+    return 0;
+}
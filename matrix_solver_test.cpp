@@ -1,296 +1,7763 @@
 #include <iostream>
 #include <vector>
 #include <sstream>
+#include <fstream>
 #include <map>
 #include <string>
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <initializer_list>
+#include <charconv>
+#include <system_error>
+#include <cmath>
+#include <complex>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <cctype>
+#include <limits>
+#include <type_traits>
+#include <algorithm>
+#include <cstdlib>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <queue>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
 
-class Matrix {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define MATRIX_HAVE_X86_DISPATCH 1
+#else
+#define MATRIX_HAVE_X86_DISPATCH 0
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#define MATRIX_HAVE_MMAP 1
+#define MATRIX_HAVE_UNIX_SOCKETS 1
+#else
+#define MATRIX_HAVE_MMAP 0
+#define MATRIX_HAVE_UNIX_SOCKETS 0
+#endif
+
+// Instrumentation
+//
+// Per-operation call counts, wall time, floating-point operations and bytes
+// moved, plus live and peak matrix memory. Timing is off until enabled with
+// --stats, MATRIX_STATS=1 or the "stats on" command; while it is off a Scope
+// costs one relaxed atomic load. Matrix memory is always tracked, since it is
+// one atomic add per allocation and a high-water mark only means something if
+// it has been kept from the start.
+//
+// FLOP and byte figures are the textbook counts for the operand shapes
+// (2mnk for a product, each input read and the result written once), not
+// hardware counters, so rates compare across kernels and thread counts.
+// Operations whose work depends on the values (sparse and exact solves)
+// report time and bytes only.
+namespace stats {
+
+enum class Op {
+    Parse, Print, Add, Multiply, Transpose, Duplicate, Solve, FastSolve, Factor, LUSolve,
+    ExactSolve, Eval, Save, Load, Import, SparseMultiply, SparseAdd, SparseSolve, Replay, IterativeSolve,
+    BatchMultiply, BatchTranspose, BatchSolve, TiledAdd, TiledTranspose, TiledMultiply, TiledSolve, Count
+};
+
+const char* opName(Op op) {
+    static const char* const names[] = {
+        "parse", "print", "add", "multiply", "transpose", "duplicate", "solve", "fastsolve", "factor", "lusolve",
+        "exactsolve", "eval", "save", "load", "import", "sparse_multiply", "sparse_add", "sparse_solve",
+        "replay", "itersolve", "batch_multiply", "batch_transpose", "batch_solve",
+        "tiled_add", "tiled_transpose", "tiled_multiply", "tiled_solve"
+    };
+    static_assert(sizeof(names) / sizeof(names[0]) == static_cast<size_t>(Op::Count), "one name per Op");
+    return names[static_cast<size_t>(op)];
+}
+
+struct OpCounters {
+    std::atomic<uint64_t> calls{0};
+    std::atomic<uint64_t> nanoseconds{0};
+    std::atomic<uint64_t> maxNanoseconds{0};
+    std::atomic<uint64_t> flops{0};
+    std::atomic<uint64_t> bytes{0};
+};
+
+inline std::atomic<bool> timingEnabled{false};
+inline OpCounters counters[static_cast<size_t>(Op::Count)];
+inline std::atomic<uint64_t> heapBytes{0};
+inline std::atomic<uint64_t> peakHeapBytes{0};
+inline std::atomic<uint64_t> mappedBytes{0};
+inline std::atomic<uint64_t> allocations{0};
+
+inline bool enabled() { return timingEnabled.load(std::memory_order_relaxed); }
+inline void setEnabled(bool on) { timingEnabled.store(on, std::memory_order_relaxed); }
+
+inline void raiseTo(std::atomic<uint64_t>& target, uint64_t value) {
+    uint64_t current = target.load(std::memory_order_relaxed);
+    while (value > current && !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+inline void allocated(size_t bytes) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    raiseTo(peakHeapBytes, heapBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes);
+}
+inline void released(size_t bytes) { heapBytes.fetch_sub(bytes, std::memory_order_relaxed); }
+
+// Times one operation from construction to destruction. The work figures can
+// be supplied up front or, when they depend on the result, with setWork.
+class Scope {
 public:
-    Matrix() : name(""), rows(0), columns(0), array(0, std::vector<float>(0)) {}
-    Matrix(const std::string& name, size_t rws, size_t clmns);
+    Scope(Op op, uint64_t flops = 0, uint64_t bytes = 0) : op(op), flops(flops), bytes(bytes), active(enabled()) {
+        if (active) {
+            start = std::chrono::steady_clock::now();
+        }
+    }
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
 
-    // Accessor and Mutator
-    void setElement(size_t row, size_t col, float value);
-    float getElement(size_t row, size_t col) const;
-    void createMatrix();
-    void multiplyRow(float multiplier, size_t row);
-    float parseFraction(const std::string& fractionStr) const;
-    void addRows(float multiplier, size_t row1, size_t row2);
-    void swapRows(size_t row1, size_t row2);
-    void attemptSolution();
-    bool isEmpty() const;
-    Matrix transpose() const;
-    Matrix add(const Matrix& other) const;
-    Matrix multiply(const Matrix& other) const;
-    Matrix duplicate(const std::string& newName) const;
+    ~Scope() {
+        if (!active) {
+            return;
+        }
+        uint64_t elapsed = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count());
+        OpCounters& c = counters[static_cast<size_t>(op)];
+        c.calls.fetch_add(1, std::memory_order_relaxed);
+        c.nanoseconds.fetch_add(elapsed, std::memory_order_relaxed);
+        c.flops.fetch_add(flops, std::memory_order_relaxed);
+        c.bytes.fetch_add(bytes, std::memory_order_relaxed);
+        raiseTo(c.maxNanoseconds, elapsed);
+    }
 
-    // Print matrix
-    void print() const;
-    
-    // Get the name of the matrix
-    std::string getName() const { return name; }
+    bool isActive() const { return active; }
+    void setWork(uint64_t newFlops, uint64_t newBytes) {
+        flops = newFlops;
+        bytes = newBytes;
+    }
 
 private:
-    std::string name;
-    size_t rows;
-    size_t columns;
-    std::vector<std::vector<float>> array; // 2D vector of floats
-
-    // Helper function to parse fractions
+    Op op;
+    uint64_t flops;
+    uint64_t bytes;
+    bool active;
+    std::chrono::steady_clock::time_point start;
 };
 
-Matrix::Matrix(const std::string& name, size_t rws, size_t clmns) 
-    : name(name), rows(rws), columns(clmns), array(rws, std::vector<float>(clmns)) {
+// Multiply-adds count as two flops. Gauss-Jordan on an m x n matrix updates
+// every other row right of each of its min(m, n) pivots; LU only the rows
+// below and right of each pivot.
+inline uint64_t eliminationFlops(uint64_t m, uint64_t n) {
+    uint64_t p = std::min(m, n);
+    return m == 0 ? 0 : 2 * (m - 1) * (p * n - p * (p - 1) / 2);
 }
 
-void Matrix::setElement(size_t row, size_t col, float value) {
-    if (row < rows && col < columns) {
-        array[row][col] = value;
+inline uint64_t factorFlops(uint64_t m, uint64_t n) {
+    // 2 * sum over k < p of (m - 1 - k) * (n - 1 - k)
+    uint64_t p = std::min(m, n);
+    if (p == 0) {
+        return 0;
     }
+    uint64_t a = m - 1, b = n - 1;
+    return 2 * (p * a * b - (a + b) * p * (p - 1) / 2 + (p - 1) * p * (2 * p - 1) / 6);
 }
 
-float Matrix::getElement(size_t row, size_t col) const {
-    if (row < rows && col < columns) {
-        return array[row][col];
+// Clear the operation counters and restart the high-water mark from the
+// memory in use now
+inline void reset() {
+    for (OpCounters& c : counters) {
+        c.calls = 0;
+        c.nanoseconds = 0;
+        c.maxNanoseconds = 0;
+        c.flops = 0;
+        c.bytes = 0;
     }
-    return -1.0f; // Error value (using -1.0f to indicate an error)
+    peakHeapBytes = heapBytes.load();
+    allocations = 0;
 }
 
-void Matrix::print() const {
-    std::cout << "Matrix " << name << ":\n";
-    for (const auto& row : array) {
-        for (const auto& elem : row) {
-            std::cout << elem << "\t";
+// What the caller's named matrices hold, reported alongside the counters
+struct Holdings {
+    size_t denseCount = 0;
+    uint64_t denseBytes = 0;
+    size_t sparseCount = 0;
+    uint64_t sparseBytes = 0;
+};
+
+void report(std::ostream& out, const Holdings& held) {
+    out << "Timing is " << (enabled() ? "on" : "off") << ".\n";
+    out << "Matrices: " << held.denseCount << " dense (" << held.denseBytes << " bytes), "
+        << held.sparseCount << " sparse (" << held.sparseBytes << " bytes)\n";
+    out << "Matrix memory: " << heapBytes.load() << " bytes live, " << peakHeapBytes.load() << " bytes peak, "
+        << mappedBytes.load() << " bytes mapped, " << allocations.load() << " allocations\n";
+    bool any = false;
+    for (size_t i = 0; i < static_cast<size_t>(Op::Count); ++i) {
+        const OpCounters& c = counters[i];
+        uint64_t calls = c.calls.load();
+        if (calls == 0) {
+            continue;
         }
-        std::cout << std::endl;
+        if (!any) {
+            out << "operation\tcalls\ttotal ms\tmax ms\tGFLOP/s\tGB/s\n";
+            any = true;
+        }
+        double seconds = static_cast<double>(c.nanoseconds.load()) * 1e-9;
+        double rate = seconds > 0 ? 1e-9 / seconds : 0.0;
+        out << opName(static_cast<Op>(i)) << "\t" << calls << "\t" << seconds * 1e3 << "\t"
+            << static_cast<double>(c.maxNanoseconds.load()) * 1e-6 << "\t"
+            << static_cast<double>(c.flops.load()) * rate << "\t" << static_cast<double>(c.bytes.load()) * rate << "\n";
+    }
+    if (!any) {
+        out << "No operations recorded.\n";
     }
 }
 
-void Matrix::createMatrix() {
-    std::cout << "Enter elements for matrix " << name << " (" << rows << "x" << columns << "):\n";
-    for (size_t row = 0; row < rows; ++row) {
-        bool validInput = false;
-        while (!validInput) {
-            std::cout << "Enter " << columns << " elements for row " << row + 1 << " (separated by spaces): ";
-            std::string line;
-            std::getline(std::cin, line); // Read the entire line of input
+void writeJson(std::ostream& out, const Holdings& held) {
+    out << "{\"timing\": " << (enabled() ? "true" : "false")
+        << ", \"matrices\": {\"dense\": " << held.denseCount << ", \"dense_bytes\": " << held.denseBytes
+        << ", \"sparse\": " << held.sparseCount << ", \"sparse_bytes\": " << held.sparseBytes << "}"
+        << ", \"memory\": {\"live_bytes\": " << heapBytes.load() << ", \"peak_bytes\": " << peakHeapBytes.load()
+        << ", \"mapped_bytes\": " << mappedBytes.load() << ", \"allocations\": " << allocations.load() << "}"
+        << ", \"operations\": {";
+    const char* separator = "";
+    for (size_t i = 0; i < static_cast<size_t>(Op::Count); ++i) {
+        const OpCounters& c = counters[i];
+        if (c.calls.load() == 0) {
+            continue;
+        }
+        out << separator << "\"" << opName(static_cast<Op>(i)) << "\": {\"calls\": " << c.calls.load()
+            << ", \"nanoseconds\": " << c.nanoseconds.load() << ", \"max_nanoseconds\": " << c.maxNanoseconds.load()
+            << ", \"flops\": " << c.flops.load() << ", \"bytes\": " << c.bytes.load() << "}";
+        separator = ", ";
+    }
+    out << "}}\n";
+}
 
-            std::istringstream iss(line);
-            std::vector<float> tempRow;
-            float value;
+} // namespace stats
 
-            // Read all values from the input line
-            while (iss >> value) {
-                tempRow.push_back(value);
-            }
+// Allocator that hands out storage aligned to a cache line so matrix rows can
+// be walked with aligned vector loads.
+template <typename T, size_t Alignment = 64>
+struct AlignedAllocator {
+    using value_type = T;
 
-            // Check if the number of elements is exactly what is needed
-            if (tempRow.size() == columns) {
-                // If the size is correct, copy the values to the matrix
-                for (size_t col = 0; col < columns; ++col) {
-                    array[row][col] = tempRow[col];
-                }
-                validInput = true; // Input was valid, exit the loop
-            } else if (tempRow.size() < columns) {
-                // Not enough elements, prompt the user to retry
-                std::cerr << "Error: Not enough elements provided for row " << row + 1 << ". Please try again.\n";
+    template <typename U>
+    struct rebind { using other = AlignedAllocator<U, Alignment>; };
+
+    AlignedAllocator() = default;
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Alignment)));
+    }
+    void deallocate(T* p, size_t) {
+        ::operator delete(p, std::align_val_t(Alignment));
+    }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U, Alignment>&) const { return true; }
+    template <typename U>
+    bool operator!=(const AlignedAllocator<U, Alignment>&) const { return false; }
+};
+
+// Backing store for a Matrix: either a zeroed, cache-line aligned heap block
+// or a private file mapping. Mappings are MAP_PRIVATE, so writing to a loaded
+// matrix copies the touched pages instead of changing the file.
+//
+// Copies are O(1): they share the block, reference counted, until one side
+// asks for mutable access through data(), which first gives that side its own
+// heap copy. Reads through the const data() never copy, so a snapshot costs
+// nothing until it or its original is modified.
+class MatrixBuffer {
+public:
+    MatrixBuffer() = default;
+
+    explicit MatrixBuffer(size_t count) {
+        if (count > 0) {
+            block = std::make_shared<Block>(count, nullptr);
+        }
+    }
+
+    // Map count floats starting offset bytes into the file. Returns an empty
+    // buffer and sets error if the file cannot be mapped.
+    static MatrixBuffer mapFile(const std::string& path, size_t offset, size_t count, std::string& error);
+
+    float* data() {
+        if (block && block.use_count() > 1) {
+            block = std::make_shared<Block>(block->count, block->ptr);
+        }
+        return block ? block->ptr : nullptr;
+    }
+    const float* data() const { return block ? block->ptr : nullptr; }
+    size_t size() const { return block ? block->count : 0; }
+    bool isMapped() const { return block && block->mapBase != nullptr; }
+    // True while another buffer still shares this one's storage
+    bool isShared() const { return block && block.use_count() > 1; }
+
+    void swap(MatrixBuffer& other) noexcept { block.swap(other.block); }
+
+private:
+    // One heap allocation or file mapping, released with the last buffer using it
+    struct Block {
+        float* ptr = nullptr;
+        size_t count = 0;
+        void* mapBase = nullptr; // Set when ptr points into a file mapping
+        size_t mapLength = 0;
+
+        Block() = default;
+        // Heap storage holding a copy of source, or zeros when source is null
+        Block(size_t count, const float* source) : count(count) {
+            ptr = AlignedAllocator<float>().allocate(count);
+            if (source) {
+                std::copy(source, source + count, ptr);
             } else {
-                // Too many elements, prompt the user to retry
-                std::cerr << "Error: Too many elements provided for row " << row + 1 << ". Please try again.\n";
+                std::fill(ptr, ptr + count, 0.0f);
             }
+            stats::allocated(count * sizeof(float));
         }
+        Block(const Block&) = delete;
+        Block& operator=(const Block&) = delete;
+        ~Block();
+    };
+
+    std::shared_ptr<Block> block;
+};
+
+#if MATRIX_HAVE_MMAP
+MatrixBuffer MatrixBuffer::mapFile(const std::string& path, size_t offset, size_t count, std::string& error) {
+    MatrixBuffer buffer;
+    if (count == 0) {
+        return buffer;
+    }
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = std::strerror(errno);
+        return buffer;
+    }
+    size_t length = offset + count * sizeof(float);
+    void* base = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    ::close(fd); // The mapping keeps the file alive
+    if (base == MAP_FAILED) {
+        error = std::strerror(errno);
+        return buffer;
     }
+    buffer.block = std::make_shared<Block>();
+    buffer.block->mapBase = base;
+    buffer.block->mapLength = length;
+    buffer.block->ptr = reinterpret_cast<float*>(static_cast<char*>(base) + offset);
+    buffer.block->count = count;
+    stats::mappedBytes.fetch_add(length, std::memory_order_relaxed);
+    return buffer;
 }
 
-void Matrix::multiplyRow(float multiplier, size_t row) {
-    if (row < rows) { // Check if the row index is valid
-        for (size_t col = 0; col < columns; ++col) {
-            array[row][col] *= multiplier;
-        }
-        std::cout << "Multiplied row " << row + 1 << " by " << multiplier << ".\n";
-        print();
-    } else {
-        std::cerr << "Error: Row index " << row + 1 << " is out of bounds.\n";
+MatrixBuffer::Block::~Block() {
+    if (mapBase) {
+        ::munmap(mapBase, mapLength);
+        stats::mappedBytes.fetch_sub(mapLength, std::memory_order_relaxed);
+    } else if (ptr) {
+        AlignedAllocator<float>().deallocate(ptr, count);
+        stats::released(count * sizeof(float));
+    }
+}
+#else
+// No mmap: fall back to reading the data into an aligned heap buffer
+MatrixBuffer MatrixBuffer::mapFile(const std::string& path, size_t offset, size_t count, std::string& error) {
+    MatrixBuffer buffer(count);
+    std::ifstream file(path, std::ios::binary);
+    file.seekg(static_cast<std::streamoff>(offset));
+    if (!file.read(reinterpret_cast<char*>(buffer.data()), static_cast<std::streamsize>(count * sizeof(float)))) {
+        error = "short read";
+        return MatrixBuffer();
     }
+    return buffer;
 }
 
-void Matrix::addRows(float multiplier, size_t row1, size_t row2) {
-    if (row1 < rows && row2 < rows) { // Check if the row index is valid
-        for (size_t col = 0; col < columns; ++col) {
-            array[row1][col] += array[row2][col] * multiplier;
+MatrixBuffer::Block::~Block() {
+    if (ptr) {
+        AlignedAllocator<float>().deallocate(ptr, count);
+        stats::released(count * sizeof(float));
+    }
+}
+#endif
+
+// Non-owning strided window into matrix storage. Element (r, c) lives at
+// data[r * rowStride + c * colStride], so rows, columns, sub-blocks and
+// transposes are all just different strides over the same memory.
+template <typename T>
+struct MatrixView {
+    T* data = nullptr;
+    size_t rows = 0;
+    size_t columns = 0;
+    ptrdiff_t rowStride = 0;
+    ptrdiff_t colStride = 1;
+
+    T& operator()(size_t r, size_t c) const {
+        return data[static_cast<ptrdiff_t>(r) * rowStride + static_cast<ptrdiff_t>(c) * colStride];
+    }
+
+    MatrixView row(size_t r) const {
+        return {data + static_cast<ptrdiff_t>(r) * rowStride, 1, columns, rowStride, colStride};
+    }
+    MatrixView column(size_t c) const {
+        return {data + static_cast<ptrdiff_t>(c) * colStride, rows, 1, rowStride, colStride};
+    }
+    MatrixView block(size_t r, size_t c, size_t h, size_t w) const {
+        return {&(*this)(r, c), h, w, rowStride, colStride};
+    }
+    MatrixView transposed() const {
+        return {data, columns, rows, colStride, rowStride};
+    }
+
+    bool isEmpty() const { return rows == 0 || columns == 0; }
+
+    // Allow a mutable view to be passed wherever a read-only one is expected
+    operator MatrixView<const T>() const {
+        return {data, rows, columns, rowStride, colStride};
+    }
+};
+
+using FloatView = MatrixView<float>;
+using ConstFloatView = MatrixView<const float>;
+
+// Work-stealing thread pool
+//
+// Each worker owns a deque: it pops its own work from the back and steals
+// from the front of the others when it runs dry. Threads outside the pool
+// (main, or anyone calling parallelFor) share one extra deque and help run
+// tasks while they wait, so nested parallelFor calls cannot deadlock.
+//
+// The thread count comes from setThreadCount() (the --threads flag), then the
+// MATRIX_THREADS environment variable, then std::thread::hardware_concurrency.
+class ThreadPool {
+public:
+    static ThreadPool& instance() {
+        static ThreadPool pool(resolveThreadCount());
+        return pool;
+    }
+
+    // Must be called before the pool is first used to take effect
+    static void setThreadCount(size_t count) { requestedThreads() = count; }
+
+    // Number of threads that execute work, including the calling thread
+    size_t size() const { return workers.size() + 1; }
+
+    // Run fn(i) for every i in [0, count) and wait for all of them
+    template <typename F>
+    void parallelFor(size_t count, const F& fn) {
+        if (count == 0) {
+            return;
         }
-        if (multiplier != 1) {
-            std::cout << "Multiplied row " << row2 + 1 << " by " << multiplier << " and added it to row " << row1 + 1 << ".\n";
-            print();
-        } else {
-            std::cout << "Added row " << row2 + 1 << " to row " << row1 + 1 << ".\n";
-            print();
+        if (count == 1 || workers.empty()) {
+            for (size_t i = 0; i < count; ++i) {
+                fn(i);
+            }
+            return;
+        }
+
+        std::atomic<size_t> remaining(count);
+        for (size_t i = 0; i < count; ++i) {
+            Queue& queue = *queues[i % queues.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.tasks.emplace_back([&fn, &remaining, i] {
+                fn(i);
+                remaining.fetch_sub(1, std::memory_order_release);
+            });
+        }
+        pending.fetch_add(count, std::memory_order_release);
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+        }
+        wake.notify_all();
+
+        const size_t self = currentQueue();
+        while (remaining.load(std::memory_order_acquire) != 0) {
+            if (!runOne(self)) {
+                std::this_thread::yield();
+            }
         }
-    } else {
-        std::cerr << "Error: Row index " << row1 + 1 << " or " << row2 + 1 << " is out of bounds.\n";
     }
-}
 
-float Matrix::parseFraction(const std::string& fractionStr) const {
-    size_t pos = fractionStr.find('/');
-    if (pos != std::string::npos) {
-        std::string numeratorStr = fractionStr.substr(0, pos);
-        std::string denominatorStr = fractionStr.substr(pos + 1);
-        try {
-            float numerator = std::stof(numeratorStr);
-            float denominator = std::stof(denominatorStr);
-            if (denominator != 0) {
-                return numerator / denominator;
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues; // One per worker, plus one shared by outside threads
+    std::vector<std::thread> workers;
+    std::atomic<size_t> pending{0};
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    bool stopping = false;
+
+    explicit ThreadPool(size_t threads) {
+        size_t workerCount = threads > 1 ? threads - 1 : 0;
+        for (size_t i = 0; i <= workerCount; ++i) {
+            queues.push_back(std::make_unique<Queue>());
+        }
+        for (size_t i = 0; i < workerCount; ++i) {
+            workers.emplace_back([this, i] { workerLoop(i); });
+        }
+    }
+
+    static size_t& requestedThreads() {
+        static size_t count = 0;
+        return count;
+    }
+
+    static size_t resolveThreadCount() {
+        if (requestedThreads() > 0) {
+            return requestedThreads();
+        }
+        if (const char* env = std::getenv("MATRIX_THREADS")) {
+            long count = std::strtol(env, nullptr, 10);
+            if (count > 0) {
+                return static_cast<size_t>(count);
+            }
+        }
+        size_t hardware = std::thread::hardware_concurrency();
+        return hardware > 0 ? hardware : 1;
+    }
+
+    static size_t& workerIndex() {
+        static thread_local size_t index = static_cast<size_t>(-1);
+        return index;
+    }
+
+    size_t currentQueue() const {
+        size_t index = workerIndex();
+        return index < workers.size() ? index : workers.size();
+    }
+
+    // Pop from our own queue, otherwise steal from the oldest end of another
+    bool runOne(size_t self) {
+        std::function<void()> task;
+        for (size_t attempt = 0; attempt < queues.size() && !task; ++attempt) {
+            size_t victim = (self + attempt) % queues.size();
+            Queue& queue = *queues[victim];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.tasks.empty()) {
+                continue;
+            }
+            if (attempt == 0) {
+                task = std::move(queue.tasks.back());
+                queue.tasks.pop_back();
             } else {
-                throw std::invalid_argument("Denominator cannot be zero.");
+                task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
             }
-        } catch (const std::invalid_argument&) {
-            std::cerr << "Error: Invalid fraction format.\n";
-            return 0.0f; // Default to 0 if parsing fails
         }
-    } else {
-        // Not a fraction, just convert to float
-        try {
-            return std::stof(fractionStr);
-        } catch (const std::invalid_argument&) {
-            std::cerr << "Error: Invalid number format.\n";
-            return 0.0f; // Default to 0 if parsing fails
+        if (!task) {
+            return false;
+        }
+        pending.fetch_sub(1, std::memory_order_relaxed);
+        task();
+        return true;
+    }
+
+    void workerLoop(size_t index) {
+        workerIndex() = index;
+        while (true) {
+            if (runOne(index)) {
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            wake.wait(lock, [this] { return stopping || pending.load(std::memory_order_acquire) > 0; });
+            if (stopping) {
+                return;
+            }
         }
     }
+};
+
+// Below this many elements, elementwise work stays on the calling thread
+const size_t kParallelThreshold = 1 << 16;
+
+// Split [0, count) into contiguous chunks and run fn(begin, end) on each,
+// in parallel once count * costPerItem reaches kParallelThreshold. Chunk
+// boundaries only depend on count, so results never depend on thread count.
+template <typename F>
+void parallelRange(size_t count, size_t costPerItem, const F& fn) {
+    ThreadPool& pool = ThreadPool::instance();
+    if (count * costPerItem < kParallelThreshold || pool.size() == 1) {
+        fn(size_t(0), count);
+        return;
+    }
+    size_t chunk = std::max<size_t>(1, kParallelThreshold / std::max<size_t>(1, costPerItem));
+    size_t chunks = (count + chunk - 1) / chunk;
+    pool.parallelFor(chunks, [&](size_t i) {
+        fn(i * chunk, std::min(count, (i + 1) * chunk));
+    });
 }
 
-void Matrix::swapRows(size_t row1, size_t row2) {
-    if (row1 < rows && row2 < rows) { // Check if row indices are valid
-        float tmp;
-        for (size_t col = 0; col < columns; ++col) {
-            tmp = array[row1][col];
-            array[row1][col] = array[row2][col];
-            array[row2][col] = tmp;
+// Keeps a parameter out of template argument deduction, so the element type
+// comes from the destination view and the rest convert to it (mutable views to
+// const ones, float literals to double)
+template <typename T>
+struct NonDeduced {
+    using type = T;
+};
+
+template <typename T>
+using NonDeducedT = typename NonDeduced<T>::type;
+
+// View kernels. These do no bounds checking or printing; the Matrix members
+// validate indices and report progress before delegating here. They work for
+// any element type with the usual arithmetic operators.
+template <typename T>
+void scaleRow(NonDeducedT<T> multiplier, MatrixView<T> row) {
+    for (size_t c = 0; c < row.columns; ++c) {
+        row(0, c) *= multiplier;
+    }
+}
+
+template <typename T>
+void addScaledRow(NonDeducedT<T> multiplier, MatrixView<const NonDeducedT<T>> src, MatrixView<T> dst) {
+    for (size_t c = 0; c < dst.columns; ++c) {
+        dst(0, c) += src(0, c) * multiplier;
+    }
+}
+
+template <typename T>
+void swapRows(MatrixView<T> a, MatrixView<T> b) {
+    for (size_t c = 0; c < a.columns; ++c) {
+        std::swap(a(0, c), b(0, c));
+    }
+}
+
+// c = a * b with a plain i-k-j loop. Kept as the reference the blocked kernel
+// is checked against and used for products too small to be worth packing.
+template <typename T>
+void multiplyNaive(MatrixView<const NonDeducedT<T>> a, MatrixView<const NonDeducedT<T>> b, MatrixView<T> c) {
+    for (size_t i = 0; i < c.rows; ++i) {
+        for (size_t j = 0; j < c.columns; ++j) {
+            c(i, j) = T(0);
+        }
+        // i-k-j order keeps the inner loop walking rows of b and c
+        for (size_t k = 0; k < a.columns; ++k) {
+            T aik = a(i, k);
+            for (size_t j = 0; j < c.columns; ++j) {
+                c(i, j) += aik * b(k, j);
+            }
         }
-        std::cout << "Swapped row " << row1 + 1 << " with row " << row2 + 1 << ".\n";
-    } else {
-        std::cerr << "Error: Row index " << row1 + 1 << " or " << row2 + 1 << " is out of bounds.\n";
     }
 }
 
-void Matrix::attemptSolution() {
-    size_t lead = 0; // Index of the leading column
+// Transposes
+//
+// Out of place, transposeInto halves the longer side of the source until a
+// tile fits in L1, so reads and writes stay cache friendly at every level of
+// the memory hierarchy without a tuned block size. In place, a square matrix
+// swaps mirrored tiles across the diagonal; a rectangular one is packed and
+// permuted by following cycles (see Matrix::transposeInPlace).
+const size_t kTransposeTile = 32;
 
-    // First, move zero rows to the bottom
-    size_t nonZeroRow = 0;
-    for (size_t r = 0; r < rows; ++r) {
-        bool allZero = true;
-        for (size_t c = 0; c < columns - 1; ++c) {
-            if (array[r][c] != 0) {
-                allZero = false;
-                break;
+template <typename T>
+void transposeInto(MatrixView<const NonDeducedT<T>> src, MatrixView<T> dst) {
+    if (src.rows <= kTransposeTile && src.columns <= kTransposeTile) {
+        // Contiguous stores; the strided loads hit the tile's few cache lines
+        for (size_t c = 0; c < src.columns; ++c) {
+            for (size_t r = 0; r < src.rows; ++r) {
+                dst(c, r) = src(r, c);
             }
         }
-        if (allZero) {
-            // Swap this row with the row at 'nonZeroRow' which is the first zero row to be moved
-            if (r != nonZeroRow) {
-                swapRows(r, nonZeroRow);
+    } else if (src.rows >= src.columns) {
+        size_t half = src.rows / 2;
+        transposeInto<T>(src.block(0, 0, half, src.columns), dst.block(0, 0, src.columns, half));
+        transposeInto<T>(src.block(half, 0, src.rows - half, src.columns), dst.block(0, half, src.columns, src.rows - half));
+    } else {
+        size_t half = src.columns / 2;
+        transposeInto<T>(src.block(0, 0, src.rows, half), dst.block(0, 0, half, src.rows));
+        transposeInto<T>(src.block(0, half, src.rows, src.columns - half), dst.block(half, 0, src.columns - half, src.rows));
+    }
+}
+
+template <typename T>
+void transposeSquareInPlace(MatrixView<T> m) {
+    const size_t n = m.rows;
+    const size_t tiles = (n + kTransposeTile - 1) / kTransposeTile;
+    // Each pair (i, j), i < j, belongs to the tile row holding i
+    parallelRange(tiles, kTransposeTile * n / 2, [&](size_t begin, size_t end) {
+        for (size_t t = begin; t < end; ++t) {
+            size_t i0 = t * kTransposeTile;
+            size_t i1 = std::min(n, i0 + kTransposeTile);
+            for (size_t j0 = i0; j0 < n; j0 += kTransposeTile) {
+                size_t j1 = std::min(n, j0 + kTransposeTile);
+                for (size_t i = i0; i < i1; ++i) {
+                    for (size_t j = std::max(j0, i + 1); j < j1; ++j) {
+                        std::swap(m(i, j), m(j, i));
+                    }
+                }
             }
-            ++nonZeroRow; // Move to the next row to be swapped with zero rows
         }
+    });
+}
+
+// Transpose a packed m x n array into a packed n x m one. The element at
+// index k < mn - 1 belongs at k * m mod (mn - 1); each permutation cycle is
+// walked once, with one bit per element recording what has already moved.
+template <typename T>
+void transposePackedInPlace(T* a, size_t m, size_t n) {
+    if (m <= 1 || n <= 1) {
+        return; // A packed row and a packed column are the same array
+    }
+    const size_t last = m * n - 1;
+    std::vector<bool> moved(m * n, false);
+    for (size_t start = 1; start < last; ++start) {
+        if (moved[start]) {
+            continue;
+        }
+        T carried = a[start];
+        size_t k = start;
+        do {
+            k = k * m % last;
+            std::swap(a[k], carried);
+            moved[k] = true;
+        } while (k != start);
     }
+}
 
-    // Now, proceed with Gaussian elimination to RREF
-    lead = 0; // Reset lead index to start processing columns
+// Blocked GEMM
+//
+// Operands are packed into contiguous MR x KC slivers of a and KC x NR
+// slivers of b so the micro-kernel streams both from L1 while holding an
+// MR x NR tile of c in registers. KC x NR of b stays in L1, MC x KC of a in
+// L2 and KC x NC of b in L3.
+//
+// The blocked path sums in a different order than multiplyNaive and uses FMA
+// where available, so results agree with it to within
+//     |c_blocked - c_naive| <= 2 * k * FLT_EPSILON * sum_k |a_ik| * |b_kj|
+// rather than bit for bit.
+namespace gemm {
 
-    for (size_t r = 0; r < rows; ++r) {
-        // Find the pivot column
-        while (lead < columns - 1 && array[r][lead] == 0) {
-            ++lead;
-            if (lead >= columns - 1) {
-                return; // No more columns to process
+const size_t MR = 6;
+const size_t NR = 16;
+const size_t MC = 120;  // Multiple of MR
+const size_t KC = 256;
+const size_t NC = 4096; // Multiple of NR
+
+// Below this many multiply-adds the packing overhead outweighs the gain
+const size_t kBlockedThreshold = 48 * 48 * 48;
+
+using PackBuffer = std::vector<float, AlignedAllocator<float>>;
+
+// c[MR x NR] += a_packed[kc x MR] * b_packed[kc x NR]
+using MicroKernel = void (*)(size_t kc, const float* a, const float* b, float* c, ptrdiff_t ldc);
+
+void microKernelScalar(size_t kc, const float* a, const float* b, float* c, ptrdiff_t ldc) {
+    float acc[MR][NR] = {};
+    for (size_t p = 0; p < kc; ++p) {
+        for (size_t i = 0; i < MR; ++i) {
+            float ai = a[i];
+            for (size_t j = 0; j < NR; ++j) {
+                acc[i][j] += ai * b[j];
             }
         }
+        a += MR;
+        b += NR;
+    }
+    for (size_t i = 0; i < MR; ++i) {
+        for (size_t j = 0; j < NR; ++j) {
+            c[i * ldc + j] += acc[i][j];
+        }
+    }
+}
 
-        // If there is no non-zero element in this row, skip it
-        if (lead >= columns - 1 || array[r][lead] == 0) {
-            continue;
+#if MATRIX_HAVE_X86_DISPATCH
+__attribute__((target("avx2,fma")))
+void microKernelAvx2(size_t kc, const float* a, const float* b, float* c, ptrdiff_t ldc) {
+    __m256 acc[MR][2];
+#pragma GCC unroll 6
+    for (size_t i = 0; i < MR; ++i) {
+        acc[i][0] = _mm256_setzero_ps();
+        acc[i][1] = _mm256_setzero_ps();
+    }
+    for (size_t p = 0; p < kc; ++p) {
+        __m256 b0 = _mm256_load_ps(b);
+        __m256 b1 = _mm256_load_ps(b + 8);
+#pragma GCC unroll 6
+        for (size_t i = 0; i < MR; ++i) {
+            __m256 ai = _mm256_broadcast_ss(a + i);
+            acc[i][0] = _mm256_fmadd_ps(ai, b0, acc[i][0]);
+            acc[i][1] = _mm256_fmadd_ps(ai, b1, acc[i][1]);
+        }
+        a += MR;
+        b += NR;
+    }
+#pragma GCC unroll 6
+    for (size_t i = 0; i < MR; ++i) {
+        float* ci = c + i * ldc;
+        _mm256_storeu_ps(ci, _mm256_add_ps(_mm256_loadu_ps(ci), acc[i][0]));
+        _mm256_storeu_ps(ci + 8, _mm256_add_ps(_mm256_loadu_ps(ci + 8), acc[i][1]));
+    }
+}
+
+__attribute__((target("avx512f")))
+void microKernelAvx512(size_t kc, const float* a, const float* b, float* c, ptrdiff_t ldc) {
+    __m512 acc[MR];
+#pragma GCC unroll 6
+    for (size_t i = 0; i < MR; ++i) {
+        acc[i] = _mm512_setzero_ps();
+    }
+    for (size_t p = 0; p < kc; ++p) {
+        __m512 b0 = _mm512_load_ps(b);
+#pragma GCC unroll 6
+        for (size_t i = 0; i < MR; ++i) {
+            acc[i] = _mm512_fmadd_ps(_mm512_set1_ps(a[i]), b0, acc[i]);
+        }
+        a += MR;
+        b += NR;
+    }
+#pragma GCC unroll 6
+    for (size_t i = 0; i < MR; ++i) {
+        float* ci = c + i * ldc;
+        _mm512_storeu_ps(ci, _mm512_add_ps(_mm512_loadu_ps(ci), acc[i]));
+    }
+}
+#endif
+
+// Picks the widest kernel the CPU supports. MATRIX_SIMD=scalar|avx2|avx512
+// caps the choice, which is handy when comparing results across machines.
+MicroKernel selectMicroKernel() {
+#if MATRIX_HAVE_X86_DISPATCH
+    const char* env = std::getenv("MATRIX_SIMD");
+    std::string cap = env ? env : "";
+    __builtin_cpu_init();
+    bool avx512 = __builtin_cpu_supports("avx512f");
+    bool avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    if (cap == "scalar") {
+        return microKernelScalar;
+    }
+    if (avx512 && cap != "avx2") {
+        return microKernelAvx512;
+    }
+    if (avx2) {
+        return microKernelAvx2;
+    }
+#endif
+    return microKernelScalar;
+}
+
+MicroKernel microKernel() {
+    static const MicroKernel kernel = selectMicroKernel();
+    return kernel;
+}
+
+const char* microKernelName() {
+#if MATRIX_HAVE_X86_DISPATCH
+    if (microKernel() == microKernelAvx512) {
+        return "avx512";
+    }
+    if (microKernel() == microKernelAvx2) {
+        return "avx2";
+    }
+#endif
+    return "scalar";
+}
+
+// Copy an mc x kc block of a into MR-row slivers, zero padding the last one
+void packA(ConstFloatView a, size_t mc, size_t kc, float* out) {
+    for (size_t i0 = 0; i0 < mc; i0 += MR) {
+        size_t h = std::min(MR, mc - i0);
+        for (size_t p = 0; p < kc; ++p) {
+            for (size_t i = 0; i < h; ++i) {
+                out[i] = a(i0 + i, p);
+            }
+            for (size_t i = h; i < MR; ++i) {
+                out[i] = 0.0f;
+            }
+            out += MR;
+        }
+    }
+}
+
+// Copy a kc x nc block of b into NR-column slivers, zero padding the last one
+void packB(ConstFloatView b, size_t kc, size_t nc, float* out) {
+    for (size_t j0 = 0; j0 < nc; j0 += NR) {
+        size_t w = std::min(NR, nc - j0);
+        for (size_t p = 0; p < kc; ++p) {
+            for (size_t j = 0; j < w; ++j) {
+                out[j] = b(p, j0 + j);
+            }
+            for (size_t j = w; j < NR; ++j) {
+                out[j] = 0.0f;
+            }
+            out += NR;
+        }
+    }
+}
+
+// Run the micro-kernel over one packed mc x nc block of c
+void macroKernel(size_t mc, size_t nc, size_t kc, const float* aPacked, const float* bPacked, FloatView c) {
+    MicroKernel kernel = microKernel();
+    alignas(64) float edge[MR * NR];
+    for (size_t j0 = 0; j0 < nc; j0 += NR) {
+        size_t w = std::min(NR, nc - j0);
+        const float* bSliver = bPacked + j0 * kc;
+        for (size_t i0 = 0; i0 < mc; i0 += MR) {
+            size_t h = std::min(MR, mc - i0);
+            const float* aSliver = aPacked + i0 * kc;
+            if (h == MR && w == NR && c.colStride == 1) {
+                kernel(kc, aSliver, bSliver, &c(i0, j0), c.rowStride);
+            } else {
+                // Partial or strided tile: accumulate into scratch, then scatter
+                std::fill(edge, edge + MR * NR, 0.0f);
+                kernel(kc, aSliver, bSliver, edge, NR);
+                for (size_t i = 0; i < h; ++i) {
+                    for (size_t j = 0; j < w; ++j) {
+                        c(i0 + i, j0 + j) += edge[i * NR + j];
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Multiply-adds needed before a product is split across the thread pool
+const size_t kParallelMultiplyAdds = 128 * 128 * 128;
+
+// Compute one mc x nc tile of c over the full k range with private buffers
+void multiplyTile(ConstFloatView a, ConstFloatView b, FloatView c, PackBuffer& aPacked, PackBuffer& bPacked) {
+    const size_t k = a.columns;
+    for (size_t jc = 0; jc < c.columns; jc += NC) {
+        size_t nc = std::min(NC, c.columns - jc);
+        for (size_t pc = 0; pc < k; pc += KC) {
+            size_t kc = std::min(KC, k - pc);
+            packB(b.block(pc, jc, kc, nc), kc, nc, bPacked.data());
+            for (size_t ic = 0; ic < c.rows; ic += MC) {
+                size_t mc = std::min(MC, c.rows - ic);
+                packA(a.block(ic, pc, mc, kc), mc, kc, aPacked.data());
+                macroKernel(mc, nc, kc, aPacked.data(), bPacked.data(), c.block(ic, jc, mc, nc));
+            }
+        }
+    }
+}
+
+// c = a * b, or c += a * b when accumulating
+void multiplyBlocked(ConstFloatView a, ConstFloatView b, FloatView c, bool accumulate = false) {
+    const size_t m = c.rows;
+    const size_t n = c.columns;
+    const size_t k = a.columns;
+
+    for (size_t i = 0; i < m && !accumulate; ++i) {
+        for (size_t j = 0; j < n; ++j) {
+            c(i, j) = 0.0f;
+        }
+    }
+
+    ThreadPool& pool = ThreadPool::instance();
+    if (m * n * k < kParallelMultiplyAdds || pool.size() == 1) {
+        PackBuffer aPacked(MC * KC);
+        PackBuffer bPacked(KC * ((std::min(NC, n) + NR - 1) / NR * NR));
+        multiplyTile(a, b, c, aPacked, bPacked);
+        return;
+    }
+
+    // Tile c into MC-row bands and column chunks narrow enough to keep every
+    // thread busy. Each element is still summed over k in the same order, so
+    // the result is bit-identical whatever the thread count.
+    size_t rowTiles = (m + MC - 1) / MC;
+    size_t colChunk = NC;
+    while (colChunk > 4 * NR && rowTiles * ((n + colChunk - 1) / colChunk) < 4 * pool.size()) {
+        colChunk /= 2;
+    }
+    size_t colTiles = (n + colChunk - 1) / colChunk;
+
+    pool.parallelFor(rowTiles * colTiles, [&](size_t tile) {
+        size_t ic = (tile / colTiles) * MC;
+        size_t jc = (tile % colTiles) * colChunk;
+        size_t mc = std::min(MC, m - ic);
+        size_t nc = std::min(colChunk, n - jc);
+        PackBuffer aPacked(MC * KC);
+        PackBuffer bPacked(KC * ((nc + NR - 1) / NR * NR));
+        multiplyTile(a.block(ic, 0, mc, k), b.block(0, jc, k, nc), c.block(ic, jc, mc, nc), aPacked, bPacked);
+    });
+}
+
+} // namespace gemm
+
+// c = a * b for any element type, split across row ranges. float has its own
+// overload below that goes through the blocked SIMD kernel.
+template <typename T>
+void multiplyInto(MatrixView<const NonDeducedT<T>> a, MatrixView<const NonDeducedT<T>> b, MatrixView<T> c) {
+    parallelRange(c.rows, a.columns * c.columns, [&](size_t begin, size_t end) {
+        multiplyNaive<T>(a.block(begin, 0, end - begin, a.columns), b, c.block(begin, 0, end - begin, c.columns));
+    });
+}
+
+// c += a * b for any element type
+template <typename T>
+void multiplyAddInto(MatrixView<const NonDeducedT<T>> a, MatrixView<const NonDeducedT<T>> b, MatrixView<T> c) {
+    parallelRange(c.rows, a.columns * c.columns, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            for (size_t k = 0; k < a.columns; ++k) {
+                addScaledRow<T>(a(i, k), b.row(k), c.row(i));
+            }
+        }
+    });
+}
+
+// c = a * b. Dimensions are assumed to agree.
+void multiplyInto(ConstFloatView a, ConstFloatView b, FloatView c) {
+    if (c.rows * c.columns * a.columns < gemm::kBlockedThreshold) {
+        multiplyNaive(a, b, c);
+    } else {
+        gemm::multiplyBlocked(a, b, c);
+    }
+}
+
+// c += a * b. Dimensions are assumed to agree.
+void multiplyAddInto(ConstFloatView a, ConstFloatView b, FloatView c) {
+    if (c.rows * c.columns * a.columns < gemm::kBlockedThreshold) {
+        for (size_t i = 0; i < c.rows; ++i) {
+            for (size_t k = 0; k < a.columns; ++k) {
+                addScaledRow(a(i, k), b.row(k), c.row(i));
+            }
+        }
+    } else {
+        gemm::multiplyBlocked(a, b, c, true);
+    }
+}
+
+// Reduce an augmented matrix (last column is the right-hand side) to RREF.
+// Row operations are reported through the given callbacks so callers can
+// trace them; pass no-ops to run silently.
+template <typename T, typename ScaleFn, typename AddFn, typename SwapFn>
+void reduceToRref(MatrixView<T> m, ScaleFn onScale, AddFn onAdd, SwapFn onSwap) {
+    if (m.columns == 0) {
+        return;
+    }
+    const size_t rows = m.rows;
+    const size_t columns = m.columns;
+
+    // First, move zero rows to the bottom
+    size_t nonZeroRow = 0;
+    for (size_t r = 0; r < rows; ++r) {
+        bool allZero = true;
+        for (size_t c = 0; c < columns - 1; ++c) {
+            if (m(r, c) != 0) {
+                allZero = false;
+                break;
+            }
+        }
+        if (allZero) {
+            // Swap this row with the row at 'nonZeroRow' which is the first zero row to be moved
+            if (r != nonZeroRow) {
+                swapRows(m.row(r), m.row(nonZeroRow));
+                onSwap(r, nonZeroRow);
+            }
+            ++nonZeroRow; // Move to the next row to be swapped with zero rows
+        }
+    }
+
+    // Now, proceed with Gaussian elimination to RREF
+    size_t lead = 0; // Index of the leading column
+
+    for (size_t r = 0; r < rows; ++r) {
+        // Find the pivot column
+        while (lead < columns - 1 && m(r, lead) == 0) {
+            ++lead;
+            if (lead >= columns - 1) {
+                return; // No more columns to process
+            }
+        }
+
+        // If there is no non-zero element in this row, skip it
+        if (lead >= columns - 1 || m(r, lead) == 0) {
+            continue;
+        }
+
+        // Normalize the pivot row
+        T pivot = m(r, lead);
+        scaleRow(T(1) / pivot, m.row(r));
+        onScale(T(1) / pivot, r);
+
+        // Eliminate the column above and below the pivot
+        for (size_t i = 0; i < rows; ++i) {
+            if (i != r) {
+                T factor = m(i, lead);
+                addScaledRow(-factor, m.row(r), m.row(i));
+                onAdd(-factor, i, r);
+            }
+        }
+
+        ++lead; // Move to the next column
+    }
+}
+
+// What the reduced row echelon form of an augmented matrix says about its system
+enum class SolutionKind {
+    Unique,
+    Infinite,
+    Inconsistent
+};
+
+// Blocked Gauss-Jordan reduction of an augmented matrix to RREF.
+//
+// The forward sweep factors panels of kRrefPanel columns with partial
+// pivoting, then applies the panel to the trailing submatrix as one GEMM
+// (c += -L21 * U12), which the blocked kernel spreads across the pool. The
+// backward sweep clears entries above the pivots a block of pivot rows at a
+// time, again as a GEMM. No rows are traced.
+//
+// Entries within maxAbs * max(rows, columns) * epsilon of zero count as
+// zero, with the epsilon of the element type. Pivot rows come out first in
+// order, followed by the zero rows, so for well-posed systems the result
+// matches reduceToRref up to rounding.
+const size_t kRrefPanel = 64;
+
+template <typename T>
+SolutionKind reduceToRrefBlocked(MatrixView<T> m) {
+    using Real = decltype(std::abs(std::declval<T>()));
+    const size_t rows = m.rows;
+    const size_t columns = m.columns;
+    if (columns == 0) {
+        return SolutionKind::Unique;
+    }
+    const size_t unknowns = columns - 1;
+
+    Real maxAbs = 0;
+    for (size_t i = 0; i < rows; ++i) {
+        for (size_t j = 0; j < columns; ++j) {
+            maxAbs = std::max<Real>(maxAbs, std::abs(m(i, j)));
+        }
+    }
+    const Real tolerance = maxAbs * static_cast<Real>(std::max(rows, columns)) * std::numeric_limits<Real>::epsilon();
+
+    // Forward sweep: row echelon form with L stored below the pivots
+    std::vector<size_t> pivotCols;
+    size_t r = 0;
+    for (size_t j0 = 0; j0 < unknowns && r < rows; j0 += kRrefPanel) {
+        size_t j1 = std::min(unknowns, j0 + kRrefPanel);
+        size_t panelStart = r;
+        size_t firstPivot = pivotCols.size();
+
+        // Unblocked factorization of the panel columns only
+        for (size_t col = j0; col < j1 && r < rows; ++col) {
+            size_t pivotRow = r;
+            for (size_t i = r + 1; i < rows; ++i) {
+                if (std::abs(m(i, col)) > std::abs(m(pivotRow, col))) {
+                    pivotRow = i;
+                }
+            }
+            if (std::abs(m(pivotRow, col)) <= tolerance) {
+                continue;
+            }
+            if (pivotRow != r) {
+                swapRows(m.row(pivotRow), m.row(r));
+            }
+            T pivot = m(r, col);
+            MatrixView<const T> pivotTail = m.block(r, col + 1, 1, j1 - col - 1);
+            for (size_t i = r + 1; i < rows; ++i) {
+                T factor = m(i, col) / pivot;
+                m(i, col) = factor;
+                if (factor != T(0)) {
+                    addScaledRow(-factor, pivotTail, m.block(i, col + 1, 1, j1 - col - 1));
+                }
+            }
+            pivotCols.push_back(col);
+            ++r;
+        }
+
+        size_t panelPivots = r - panelStart;
+        if (panelPivots == 0 || j1 == columns) {
+            continue;
+        }
+
+        // U12 = L11^-1 * A12, split across column ranges
+        MatrixView<T> trailing = m.block(panelStart, j1, rows - panelStart, columns - j1);
+        parallelRange(trailing.columns, panelPivots * panelPivots, [&](size_t begin, size_t end) {
+            for (size_t i = 1; i < panelPivots; ++i) {
+                for (size_t k = 0; k < i; ++k) {
+                    T factor = m(panelStart + i, pivotCols[firstPivot + k]);
+                    if (factor != T(0)) {
+                        addScaledRow(-factor, trailing.block(k, begin, 1, end - begin),
+                                     trailing.block(i, begin, 1, end - begin));
+                    }
+                }
+            }
+        });
+
+        // A22 += -L21 * U12
+        size_t below = rows - r;
+        if (below == 0) {
+            continue;
+        }
+        std::vector<T, AlignedAllocator<T>> negL21(below * panelPivots);
+        MatrixView<T> l21{negL21.data(), below, panelPivots, static_cast<ptrdiff_t>(panelPivots), 1};
+        for (size_t i = 0; i < below; ++i) {
+            for (size_t k = 0; k < panelPivots; ++k) {
+                l21(i, k) = -m(r + i, pivotCols[firstPivot + k]);
+            }
+        }
+        multiplyAddInto(l21, trailing.block(0, 0, panelPivots, trailing.columns),
+                        trailing.block(panelPivots, 0, below, trailing.columns));
+    }
+    const size_t rank = r;
+
+    // Everything below the staircase is eliminated; make it exactly zero
+    for (size_t i = 0; i < rows; ++i) {
+        size_t end = i < rank ? pivotCols[i] : unknowns;
+        for (size_t j = 0; j < end; ++j) {
+            m(i, j) = T(0);
+        }
+    }
+
+    // Normalize the pivot rows
+    parallelRange(rank, columns, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            size_t col = pivotCols[i];
+            scaleRow(T(1) / m(i, col), m.block(i, col, 1, columns - col));
+        }
+    });
+
+    // Backward sweep: clear above the pivots, one block of pivot rows at a time
+    for (size_t i1 = rank; i1 > 0;) {
+        size_t i0 = i1 > kRrefPanel ? i1 - kRrefPanel : 0;
+        size_t firstCol = pivotCols[i0];
+
+        // Within the block
+        for (size_t i = i1; i-- > i0 + 1;) {
+            size_t col = pivotCols[i];
+            for (size_t k = i0; k < i; ++k) {
+                T factor = m(k, col);
+                if (factor != T(0)) {
+                    addScaledRow(-factor, m.block(i, col, 1, columns - col), m.block(k, col, 1, columns - col));
+                }
+            }
+        }
+
+        // Rows above the block: A[0:i0, firstCol:] += -A[0:i0, pivots] * A[i0:i1, firstCol:]
+        if (i0 > 0) {
+            size_t blockPivots = i1 - i0;
+            std::vector<T, AlignedAllocator<T>> coefficients(i0 * blockPivots);
+            MatrixView<T> coeff{coefficients.data(), i0, blockPivots, static_cast<ptrdiff_t>(blockPivots), 1};
+            for (size_t k = 0; k < i0; ++k) {
+                for (size_t i = 0; i < blockPivots; ++i) {
+                    coeff(k, i) = -m(k, pivotCols[i0 + i]);
+                }
+            }
+            multiplyAddInto(coeff, m.block(i0, firstCol, blockPivots, columns - firstCol),
+                            m.block(0, firstCol, i0, columns - firstCol));
+        }
+        i1 = i0;
+    }
+
+    // Pivot columns are exactly unit vectors
+    for (size_t i = 0; i < rank; ++i) {
+        for (size_t k = 0; k < rows; ++k) {
+            m(k, pivotCols[i]) = k == i ? T(1) : T(0);
+        }
+    }
+
+    for (size_t i = rank; i < rows; ++i) {
+        if (std::abs(m(i, unknowns)) > tolerance) {
+            return SolutionKind::Inconsistent;
+        }
+    }
+    return rank < unknowns ? SolutionKind::Infinite : SolutionKind::Unique;
+}
+
+// Text parsing
+//
+// Exception-free and allocation-free: everything works on [first, last)
+// character ranges. Numbers are anything std::from_chars accepts for float,
+// with an optional leading '+', or a fraction a/b of two such numbers.
+bool parsePlainNumber(const char* first, const char* last, float& value) {
+    if (first != last && *first == '+' && last - first > 1 && first[1] != '-' && first[1] != '+') {
+        ++first;
+    }
+    auto result = std::from_chars(first, last, value);
+    return first != last && result.ec == std::errc() && result.ptr == last;
+}
+
+bool parseNumber(const char* first, const char* last, float& value) {
+    const char* slash = std::find(first, last, '/');
+    float numerator;
+    if (!parsePlainNumber(first, slash, numerator)) {
+        return false;
+    }
+    if (slash == last) {
+        value = numerator;
+        return true;
+    }
+    float denominator;
+    if (!parsePlainNumber(slash + 1, last, denominator) || denominator == 0) {
+        return false;
+    }
+    value = numerator / denominator;
+    return true;
+}
+
+bool isFieldSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+// Outcome of parsing one row of values
+enum class RowParse {
+    Ok,
+    InvalidNumber, // badToken is set to the offending field
+    TooFew,
+    TooMany
+};
+
+// Parse the fields of one line into out[0, expected). Fields are separated
+// by whitespace, or by commas (with optional surrounding spaces) when csv is
+// set. count receives the number of fields seen.
+RowParse parseRow(const char* first, const char* last, bool csv, float* out, size_t expected,
+                  size_t& count, std::pair<const char*, const char*>& badToken) {
+    count = 0;
+    const char* p = first;
+    while (true) {
+        while (p != last && isFieldSpace(*p)) {
+            ++p;
+        }
+        if (p == last) {
+            if (csv && count > 0) {
+                badToken = {p, p}; // Trailing comma leaves an empty field
+                return RowParse::InvalidNumber;
+            }
+            break;
+        }
+        const char* tokenEnd = p;
+        while (tokenEnd != last && !isFieldSpace(*tokenEnd) && !(csv && *tokenEnd == ',')) {
+            ++tokenEnd;
+        }
+        float value;
+        if (!parseNumber(p, tokenEnd, value)) {
+            badToken = {p, tokenEnd};
+            return RowParse::InvalidNumber;
+        }
+        if (count < expected) {
+            out[count] = value;
+        }
+        ++count;
+        p = tokenEnd;
+        if (csv) {
+            while (p != last && isFieldSpace(*p)) {
+                ++p;
+            }
+            if (p == last) {
+                break;
+            }
+            if (*p != ',') {
+                badToken = {p, p + 1};
+                return RowParse::InvalidNumber;
+            }
+            ++p;
+        }
+    }
+    if (count < expected) {
+        return RowParse::TooFew;
+    }
+    return count > expected ? RowParse::TooMany : RowParse::Ok;
+}
+
+// Replacing files
+//
+// Saves and exports write a uniquely named temporary file next to the target
+// and rename it over the target once it is complete, so concurrent saves to
+// one path never write into the same temporary. A failed write leaves the old file
+// untouched, and a matrix loaded from the target keeps its mapping: rename
+// swaps the directory entry, while the mapping holds on to the old file.
+// Truncating or rewriting the file in place would pull the data out from
+// under the mapping instead, so nothing here ever does.
+template <typename F>
+bool replaceFile(const std::string& path, F write) {
+#if MATRIX_HAVE_MMAP
+    std::string temporary = path + ".XXXXXX";
+    int fd = ::mkstemp(&temporary[0]);
+    if (fd < 0) {
+        return false;
+    }
+    // mkstemp creates the file private; give it the target's mode, or the
+    // mode a plain open would have given a new file
+    struct stat existing;
+    mode_t mode;
+    if (::stat(path.c_str(), &existing) == 0) {
+        mode = existing.st_mode & 07777;
+    } else {
+        mode_t mask = ::umask(0);
+        ::umask(mask);
+        mode = 0666 & ~mask;
+    }
+    ::fchmod(fd, mode);
+    ::close(fd);
+#else
+    const std::string temporary = path + ".tmp";
+#endif
+    bool written;
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        written = file && write(file) && file.flush();
+    }
+    if (written && std::rename(temporary.c_str(), path.c_str()) == 0) {
+        return true;
+    }
+    std::remove(temporary.c_str());
+    return false;
+}
+
+// Text output
+//
+// OutputBuffer formats numbers with std::to_chars into a 64 KiB buffer and
+// hands the stream whole buffers, instead of paying for operator<<'s sentry
+// and locale lookup on every element and a flush on every row. Printing a
+// large matrix becomes a handful of write calls.
+class OutputBuffer {
+public:
+    explicit OutputBuffer(std::ostream& out) : out(out) {}
+    OutputBuffer(const OutputBuffer&) = delete;
+    OutputBuffer& operator=(const OutputBuffer&) = delete;
+    ~OutputBuffer() { flush(); }
+
+    void put(char c) {
+        if (used == kCapacity) {
+            drain();
+        }
+        buffer[used++] = c;
+    }
+    void put(const std::string& text) { put(text.data(), text.size()); }
+    void put(const char* text, size_t length) {
+        if (length > kCapacity - used) {
+            drain();
+            if (length > kCapacity) {
+                out.write(text, static_cast<std::streamsize>(length));
+                return;
+            }
+        }
+        std::memcpy(buffer + used, text, length);
+        used += length;
+    }
+
+    // The same text operator<< gives for a float on a default stream: %g with
+    // 6 significant digits
+    void putFloat(float value) { putNumber(value, true); }
+    // The shortest text that reads back as exactly the same float
+    void putExact(float value) { putNumber(value, false); }
+    void putIndex(size_t value) {
+        room(24);
+        used = static_cast<size_t>(std::to_chars(buffer + used, buffer + kCapacity, value).ptr - buffer);
+    }
+
+    // Hand everything buffered to the stream and flush it
+    void flush() {
+        drain();
+        out.flush();
+    }
+
+private:
+    static const size_t kCapacity = 1 << 16;
+    std::ostream& out;
+    char buffer[kCapacity];
+    size_t used = 0;
+
+    void drain() {
+        out.write(buffer, static_cast<std::streamsize>(used));
+        used = 0;
+    }
+    void room(size_t length) {
+        if (kCapacity - used < length) {
+            drain();
+        }
+    }
+    void putNumber(float value, bool general) {
+        room(32); // Longest float either way, e.g. -1.17549435e-38
+        char* end = general ? std::to_chars(buffer + used, buffer + kCapacity, value, std::chars_format::general, 6).ptr
+                            : std::to_chars(buffer + used, buffer + kCapacity, value).ptr;
+        used = static_cast<size_t>(end - buffer);
+    }
+};
+
+// Matrices with more elements than this print summarized: the first and last
+// kPrintEdgeItems rows and columns, with "..." for the rest
+const size_t kPrintSummaryThreshold = 1000;
+const size_t kPrintEdgeItems = 3;
+
+// Where a summarized print skips from the leading items to the trailing ones;
+// count when nothing is skipped
+inline size_t printGapStart(size_t count, bool summarize) {
+    return summarize && count > 2 * kPrintEdgeItems ? kPrintEdgeItems : count;
+}
+
+// How much row-operation tracing Matrix reports
+enum class Verbosity {
+    Silent = 0, // Nothing but errors; results only appear when printed explicitly
+    Steps = 1,  // One line per row operation
+    Trace = 2   // One line per row operation followed by the whole matrix
+};
+
+// Journal of the row operations applied to a matrix by hand. Scaling a row
+// or adding to it keeps the values it overwrites, so every step undoes exactly
+// in O(columns); a swap is its own inverse. Undone steps stay available for
+// redo until a new step is recorded.
+class RowJournal {
+public:
+    struct Step {
+        enum class Kind { Scale, Add, Swap };
+        Kind kind;
+        float multiplier; // Scale and Add: row1 *= multiplier or row1 += multiplier * row2
+        size_t row1;
+        size_t row2;      // Add and Swap
+        size_t saved;     // Scale and Add: offset of row1's previous values in savedRows
+    };
+
+    // Steps currently applied, oldest first
+    const Step* begin() const { return steps.data(); }
+    const Step* end() const { return steps.data() + applied; }
+    size_t size() const { return applied; }
+    bool canUndo() const { return applied > 0; }
+    bool canRedo() const { return applied < steps.size(); }
+
+    // Rows a matrix needs for the applied steps to be replayed on it
+    size_t rowsNeeded() const {
+        size_t needed = 0;
+        for (const Step& step : *this) {
+            needed = std::max({needed, step.row1 + 1, step.kind == Step::Kind::Scale ? 0 : step.row2 + 1});
+        }
+        return needed;
+    }
+
+    // Record a step about to be applied, dropping anything undone. before
+    // holds row1's current values for Scale and Add.
+    void record(Step step, const float* before, size_t columns) {
+        if (applied < steps.size()) {
+            steps.resize(applied);
+            savedRows.resize(savedRowsEnd());
+        }
+        rowWidth = columns;
+        if (step.kind != Step::Kind::Swap) {
+            step.saved = savedRows.size();
+            savedRows.insert(savedRows.end(), before, before + columns);
+        }
+        steps.push_back(step);
+        ++applied;
+    }
+
+    const Step& undo() { return steps[--applied]; }
+    const Step& redo() { return steps[applied++]; }
+    const float* savedRow(const Step& step) const { return savedRows.data() + step.saved; }
+
+    void clear() {
+        if (!steps.empty()) {
+            steps.clear();
+            savedRows.clear();
+            applied = 0;
+        }
+    }
+
+private:
+    std::vector<Step> steps;
+    std::vector<float> savedRows; // One row of rowWidth values per Scale or Add step
+    size_t applied = 0;
+    size_t rowWidth = 0;
+
+    // End of the values saved by the remaining steps; swaps save nothing
+    size_t savedRowsEnd() const {
+        for (size_t i = steps.size(); i-- > 0;) {
+            if (steps[i].kind != Step::Kind::Swap) {
+                return steps[i].saved + rowWidth;
+            }
+        }
+        return 0;
+    }
+};
+
+// Size of the column tiles replayRowSteps works through
+constexpr size_t kReplayTileBytes = 128 * 1024;
+
+// Apply the journal's steps to m in one pass over the data. The columns are
+// cut into tiles narrow enough that a tile of every row fits in L2, and each
+// tile runs through the whole sequence before the next is touched. Tiles are
+// independent, so they also run in parallel. Each element sees the same
+// operations in the same order as stepping one at a time, so the results
+// match bit for bit.
+void replayRowSteps(const RowJournal& journal, FloatView m) {
+    const size_t lineFloats = 64 / sizeof(float);
+    size_t tile = kReplayTileBytes / sizeof(float) / std::max<size_t>(1, m.rows) / lineFloats * lineFloats;
+    tile = std::max(tile, lineFloats);
+    size_t tiles = (m.columns + tile - 1) / tile;
+    parallelRange(tiles, journal.size() * tile, [&](size_t begin, size_t end) {
+        for (size_t t = begin; t < end; ++t) {
+            size_t first = t * tile;
+            FloatView block = m.block(0, first, m.rows, std::min(tile, m.columns - first));
+            for (const RowJournal::Step& step : journal) {
+                switch (step.kind) {
+                    case RowJournal::Step::Kind::Scale:
+                        scaleRow(step.multiplier, block.row(step.row1));
+                        break;
+                    case RowJournal::Step::Kind::Add:
+                        addScaledRow(step.multiplier, block.row(step.row2), block.row(step.row1));
+                        break;
+                    case RowJournal::Step::Kind::Swap:
+                        swapRows(block.row(step.row1), block.row(step.row2));
+                        break;
+                }
+            }
+        }
+    });
+}
+
+class LUFactorization;
+
+class Matrix {
+public:
+    Matrix() : name(""), rows(0), columns(0), ld(0) {}
+    Matrix(const std::string& name, size_t rws, size_t clmns);
+
+    // Accessor and Mutator
+    void setElement(size_t row, size_t col, float value);
+    float getElement(size_t row, size_t col) const;
+    void createMatrix();
+    void multiplyRow(float multiplier, size_t row);
+    float parseFraction(const std::string& fractionStr) const;
+    void addRows(float multiplier, size_t row1, size_t row2);
+    void swapRows(size_t row1, size_t row2);
+    void attemptSolution();
+    SolutionKind fastSolve(); // Untraced reduction to RREF, sparse when mostly zeros
+
+    // multiplyRow, addRows and swapRows are journaled; any other change to the
+    // matrix clears the journal. undo and redo return false when there is
+    // nothing to undo or redo.
+    bool undo();
+    bool redo();
+    const RowJournal& journal() const { return rowJournal; }
+    bool replay(const RowJournal& steps); // Apply another matrix's steps in one fused pass
+    bool isEmpty() const;
+    Matrix transpose() const;
+    void transposeInPlace(); // No second copy of the data when the padded rows fit
+    Matrix add(const Matrix& other) const;
+    Matrix multiply(const Matrix& other) const;
+    Matrix duplicate(const std::string& newName) const; // O(1); the data is copied on first write
+
+    // Binary .mtxb files. load maps the file rather than reading it and only
+    // checks the data checksum when asked to; errors return an empty matrix.
+    // The mapping reads the file lazily, so a loaded file must not be
+    // truncated or rewritten in place while the matrix uses it. save replaces
+    // files by rename (see replaceFile), so saving over it is safe.
+    bool save(const std::string& path) const;
+    static Matrix load(const std::string& path, const std::string& name, bool verify = false);
+
+    // PLU factorization, computed on first use and reused until the matrix changes
+    std::shared_ptr<const LUFactorization> factorization() const;
+
+    // Zero-copy views over the underlying storage. Taking a mutable view
+    // drops any cached factorization and the row-operation journal.
+    FloatView view() { rowJournal.clear(); return storageView(); }
+    ConstFloatView view() const { return {data.data(), rows, columns, static_cast<ptrdiff_t>(ld), 1}; }
+    FloatView row(size_t r) { return view().row(r); }
+    ConstFloatView row(size_t r) const { return view().row(r); }
+    FloatView column(size_t c) { return view().column(c); }
+    ConstFloatView column(size_t c) const { return view().column(c); }
+    FloatView block(size_t r, size_t c, size_t h, size_t w) { return view().block(r, c, h, w); }
+    ConstFloatView block(size_t r, size_t c, size_t h, size_t w) const { return view().block(r, c, h, w); }
+    ConstFloatView transposedView() const { return view().transposed(); }
+
+    size_t rowCount() const { return rows; }
+    size_t columnCount() const { return columns; }
+    // Distance in floats between the starts of consecutive rows
+    size_t leadingDimension() const { return ld; }
+    // Element storage in bytes, row padding included. Duplicates share their
+    // storage until one of them is modified, so these can overlap.
+    size_t memoryBytes() const { return data.size() * sizeof(float); }
+
+    // Print matrix; ones with more than kPrintSummaryThreshold elements are
+    // summarized unless full is set
+    void print(bool full = false) const;
+
+    // Plain exports for other tools: CSV with every value written exactly, or
+    // raw row-major float32 in host byte order with no header
+    bool exportCsv(const std::string& path) const;
+    bool exportRaw(const std::string& path) const;
+
+    // Applies to every matrix; interactive sessions default to Trace
+    static void setVerbosity(Verbosity level) { verbosity = level; }
+    static Verbosity getVerbosity() { return verbosity; }
+
+    // Get the name of the matrix
+    std::string getName() const { return name; }
+    void setName(const std::string& newName) { name = newName; }
+
+private:
+    std::string name;
+    size_t rows;
+    size_t columns;
+    size_t ld; // Leading dimension (padded row length)
+    MatrixBuffer data; // Contiguous row-major storage
+    mutable std::shared_ptr<const LUFactorization> cachedLU;
+    RowJournal rowJournal;
+
+    static inline Verbosity verbosity = Verbosity::Trace;
+
+    // Report a row operation that has already been applied
+    void reportScale(float multiplier, size_t row) const;
+    void reportAdd(float multiplier, size_t row1, size_t row2) const;
+    void reportSwap(size_t row1, size_t row2) const;
+    void reportStep(const RowJournal::Step& step) const;
+
+    // Rows wider than a cache line are padded so each one starts aligned
+    static size_t paddedWidth(size_t clmns) {
+        const size_t lineFloats = 64 / sizeof(float);
+        return clmns <= lineFloats ? clmns : (clmns + lineFloats - 1) / lineFloats * lineFloats;
+    }
+    // Mutable access for the journaled row operations, which keep the journal
+    FloatView storageView() { cachedLU.reset(); return {data.data(), rows, columns, static_cast<ptrdiff_t>(ld), 1}; }
+    float* rowPtr(size_t r) { rowJournal.clear(); return storageView().data + r * ld; }
+    const float* rowPtr(size_t r) const { return data.data() + r * ld; }
+};
+
+Matrix::Matrix(const std::string& name, size_t rws, size_t clmns)
+    : name(name), rows(rws), columns(clmns), ld(paddedWidth(clmns)), data(rws * paddedWidth(clmns)) {
+}
+
+void Matrix::setElement(size_t row, size_t col, float value) {
+    if (row < rows && col < columns) {
+        rowPtr(row)[col] = value;
+    }
+}
+
+float Matrix::getElement(size_t row, size_t col) const {
+    if (row < rows && col < columns) {
+        return rowPtr(row)[col];
+    }
+    return -1.0f; // Error value (using -1.0f to indicate an error)
+}
+
+void Matrix::print(bool full) const {
+    const bool summarize = !full && rows * columns > kPrintSummaryThreshold;
+    const size_t rowGap = printGapStart(rows, summarize);
+    const size_t colGap = printGapStart(columns, summarize);
+    const size_t shownRows = rowGap < rows ? 2 * kPrintEdgeItems : rows;
+    const size_t shownColumns = colGap < columns ? 2 * kPrintEdgeItems : columns;
+    stats::Scope scope(stats::Op::Print, 0, shownRows * shownColumns * sizeof(float));
+
+    OutputBuffer out(std::cout);
+    out.put("Matrix " + name);
+    if (summarize) {
+        out.put(" (", 2);
+        out.putIndex(rows);
+        out.put('x');
+        out.putIndex(columns);
+        out.put(')');
+    }
+    out.put(":\n", 2);
+    for (size_t r = 0; r < rows; ++r) {
+        if (r == rowGap) {
+            out.put("...\n", 4);
+            r = rows - kPrintEdgeItems;
+        }
+        const float* rowData = rowPtr(r);
+        for (size_t c = 0; c < columns; ++c) {
+            if (c == colGap) {
+                out.put("...\t", 4);
+                c = columns - kPrintEdgeItems;
+            }
+            out.putFloat(rowData[c]);
+            out.put('\t');
+        }
+        out.put('\n');
+    }
+}
+
+bool Matrix::exportCsv(const std::string& path) const {
+    stats::Scope scope(stats::Op::Save, 0, rows * columns * sizeof(float));
+    bool written = replaceFile(path, [&](std::ofstream& file) {
+        OutputBuffer out(file);
+        for (size_t r = 0; r < rows; ++r) {
+            const float* rowData = rowPtr(r);
+            for (size_t c = 0; c < columns; ++c) {
+                if (c > 0) {
+                    out.put(',');
+                }
+                out.putExact(rowData[c]);
+            }
+            out.put('\n');
+        }
+        out.flush();
+        return bool(file);
+    });
+    if (!written) {
+        std::cerr << "Error: Could not write matrix " << name << " to " << path << ".\n";
+        return false;
+    }
+    return true;
+}
+
+bool Matrix::exportRaw(const std::string& path) const {
+    stats::Scope scope(stats::Op::Save, 0, rows * columns * sizeof(float));
+    bool written = replaceFile(path, [&](std::ofstream& file) {
+        // Rows without their padding
+        OutputBuffer out(file);
+        for (size_t r = 0; r < rows; ++r) {
+            out.put(reinterpret_cast<const char*>(rowPtr(r)), columns * sizeof(float));
+        }
+        out.flush();
+        return bool(file);
+    });
+    if (!written) {
+        std::cerr << "Error: Could not write matrix " << name << " to " << path << ".\n";
+        return false;
+    }
+    return true;
+}
+
+void Matrix::createMatrix() {
+    stats::Scope scope(stats::Op::Parse, 0, rows * columns * sizeof(float));
+    std::cout << "Enter elements for matrix " << name << " (" << rows << "x" << columns << "):\n";
+    std::vector<float> tempRow(columns);
+    std::string line;
+    for (size_t row = 0; row < rows; ++row) {
+        bool validInput = false;
+        while (!validInput) {
+            std::cout << "Enter " << columns << " elements for row " << row + 1 << " (separated by spaces): ";
+            if (!std::getline(std::cin, line)) { // Read the entire line of input
+                return;
+            }
+
+            // Parse the whole line; values may be fractions like 1/4
+            size_t count;
+            std::pair<const char*, const char*> badToken;
+            RowParse status = parseRow(line.data(), line.data() + line.size(), false, tempRow.data(), columns, count, badToken);
+
+            // Check if the number of elements is exactly what is needed
+            if (status == RowParse::Ok) {
+                // If the size is correct, copy the values to the matrix
+                std::copy(tempRow.begin(), tempRow.end(), rowPtr(row));
+                validInput = true; // Input was valid, exit the loop
+            } else if (status == RowParse::InvalidNumber) {
+                std::cerr << "Error: Invalid number " << std::string(badToken.first, badToken.second) << " in row " << row + 1 << ". Please try again.\n";
+            } else if (status == RowParse::TooFew) {
+                // Not enough elements, prompt the user to retry
+                std::cerr << "Error: Not enough elements provided for row " << row + 1 << ". Please try again.\n";
+            } else {
+                // Too many elements, prompt the user to retry
+                std::cerr << "Error: Too many elements provided for row " << row + 1 << ". Please try again.\n";
+            }
+        }
+    }
+}
+
+void Matrix::reportScale(float multiplier, size_t row) const {
+    if (verbosity >= Verbosity::Steps) {
+        std::cout << "Multiplied row " << row + 1 << " by " << multiplier << ".\n";
+    }
+    if (verbosity >= Verbosity::Trace) {
+        print();
+    }
+}
+
+void Matrix::reportAdd(float multiplier, size_t row1, size_t row2) const {
+    if (verbosity >= Verbosity::Steps) {
+        if (multiplier != 1) {
+            std::cout << "Multiplied row " << row2 + 1 << " by " << multiplier << " and added it to row " << row1 + 1 << ".\n";
+        } else {
+            std::cout << "Added row " << row2 + 1 << " to row " << row1 + 1 << ".\n";
+        }
+    }
+    if (verbosity >= Verbosity::Trace) {
+        print();
+    }
+}
+
+void Matrix::reportSwap(size_t row1, size_t row2) const {
+    if (verbosity >= Verbosity::Steps) {
+        std::cout << "Swapped row " << row1 + 1 << " with row " << row2 + 1 << ".\n";
+    }
+}
+
+void Matrix::reportStep(const RowJournal::Step& step) const {
+    switch (step.kind) {
+        case RowJournal::Step::Kind::Scale:
+            reportScale(step.multiplier, step.row1);
+            break;
+        case RowJournal::Step::Kind::Add:
+            reportAdd(step.multiplier, step.row1, step.row2);
+            break;
+        case RowJournal::Step::Kind::Swap:
+            reportSwap(step.row1, step.row2);
+            break;
+    }
+}
+
+void Matrix::multiplyRow(float multiplier, size_t row) {
+    if (row < rows) { // Check if the row index is valid
+        FloatView target = storageView().row(row);
+        rowJournal.record({RowJournal::Step::Kind::Scale, multiplier, row, 0, 0}, target.data, columns);
+        scaleRow(multiplier, target);
+        reportScale(multiplier, row);
+    } else {
+        std::cerr << "Error: Row index " << row + 1 << " is out of bounds.\n";
+    }
+}
+
+void Matrix::addRows(float multiplier, size_t row1, size_t row2) {
+    if (row1 < rows && row2 < rows) { // Check if the row index is valid
+        FloatView m = storageView();
+        rowJournal.record({RowJournal::Step::Kind::Add, multiplier, row1, row2, 0}, m.row(row1).data, columns);
+        addScaledRow(multiplier, m.row(row2), m.row(row1));
+        reportAdd(multiplier, row1, row2);
+    } else {
+        std::cerr << "Error: Row index " << row1 + 1 << " or " << row2 + 1 << " is out of bounds.\n";
+    }
+}
+
+float Matrix::parseFraction(const std::string& fractionStr) const {
+    const char* first = fractionStr.data();
+    const char* last = first + fractionStr.size();
+    while (first != last && isFieldSpace(*first)) {
+        ++first;
+    }
+    while (last != first && isFieldSpace(last[-1])) {
+        --last;
+    }
+    float value;
+    if (parseNumber(first, last, value)) {
+        return value;
+    }
+    if (std::find(first, last, '/') != last) {
+        std::cerr << "Error: Invalid fraction format.\n";
+    } else {
+        std::cerr << "Error: Invalid number format.\n";
+    }
+    return 0.0f; // Default to 0 if parsing fails
+}
+
+void Matrix::swapRows(size_t row1, size_t row2) {
+    if (row1 < rows && row2 < rows) { // Check if row indices are valid
+        FloatView m = storageView();
+        rowJournal.record({RowJournal::Step::Kind::Swap, 1.0f, row1, row2, 0}, nullptr, columns);
+        ::swapRows(m.row(row1), m.row(row2));
+        reportSwap(row1, row2);
+    } else {
+        std::cerr << "Error: Row index " << row1 + 1 << " or " << row2 + 1 << " is out of bounds.\n";
+    }
+}
+
+bool Matrix::undo() {
+    if (!rowJournal.canUndo()) {
+        return false;
+    }
+    const RowJournal::Step& step = rowJournal.undo();
+    FloatView m = storageView();
+    if (step.kind == RowJournal::Step::Kind::Swap) {
+        ::swapRows(m.row(step.row1), m.row(step.row2));
+    } else {
+        const float* saved = rowJournal.savedRow(step);
+        std::copy(saved, saved + columns, m.row(step.row1).data);
+    }
+    if (verbosity >= Verbosity::Steps) {
+        std::cout << "Undid: ";
+    }
+    reportStep(step);
+    return true;
+}
+
+bool Matrix::redo() {
+    if (!rowJournal.canRedo()) {
+        return false;
+    }
+    const RowJournal::Step& step = rowJournal.redo();
+    FloatView m = storageView();
+    switch (step.kind) {
+        case RowJournal::Step::Kind::Scale:
+            scaleRow(step.multiplier, m.row(step.row1));
+            break;
+        case RowJournal::Step::Kind::Add:
+            addScaledRow(step.multiplier, m.row(step.row2), m.row(step.row1));
+            break;
+        case RowJournal::Step::Kind::Swap:
+            ::swapRows(m.row(step.row1), m.row(step.row2));
+            break;
+    }
+    if (verbosity >= Verbosity::Steps) {
+        std::cout << "Redid: ";
+    }
+    reportStep(step);
+    return true;
+}
+
+bool Matrix::replay(const RowJournal& steps) {
+    if (&steps == &rowJournal) {
+        // Replaying clears this matrix's own journal, so work from a copy
+        RowJournal copy = steps;
+        return replay(copy);
+    }
+    if (steps.rowsNeeded() > rows) {
+        std::cerr << "Error: The row operations need " << steps.rowsNeeded() << " rows but matrix " << name
+                  << " has " << rows << ".\n";
+        return false;
+    }
+    stats::Scope scope(stats::Op::Replay, 2 * steps.size() * columns, 2 * rows * columns * sizeof(float));
+    replayRowSteps(steps, view());
+    if (verbosity >= Verbosity::Steps) {
+        std::cout << "Replayed " << steps.size() << " row operations on matrix " << name << ".\n";
+    }
+    if (verbosity >= Verbosity::Trace) {
+        print();
+    }
+    return true;
+}
+
+void Matrix::attemptSolution() {
+    stats::Scope scope(stats::Op::Solve, stats::eliminationFlops(rows, columns), 2 * rows * columns * sizeof(float));
+    // The kernel has already applied each step; just report it
+    reduceToRref(view(),
+        [this](float multiplier, size_t r) { reportScale(multiplier, r); },
+        [this](float multiplier, size_t row1, size_t row2) { reportAdd(multiplier, row1, row2); },
+        [this](size_t row1, size_t row2) { reportSwap(row1, row2); });
+}
+
+Matrix Matrix::transpose() const {
+    stats::Scope scope(stats::Op::Transpose, 0, 2 * rows * columns * sizeof(float));
+    Matrix transposedMatrix(name, columns, rows);
+    ConstFloatView src = view();
+    FloatView dst = transposedMatrix.view();
+
+    // Each band of source rows becomes a band of destination columns
+    parallelRange(rows, columns, [&](size_t begin, size_t end) {
+        transposeInto(src.block(begin, 0, end - begin, columns), dst.block(0, begin, columns, end - begin));
+    });
+
+    return transposedMatrix;
+}
+
+void Matrix::transposeInPlace() {
+    rowJournal.clear();
+    // Writing shared data would copy it first anyway, and a tall matrix may
+    // need more padding than its buffer holds once its rows are columns;
+    // either way transpose into a new buffer. transpose() records itself.
+    if (!isEmpty() && (data.isShared() || columns * paddedWidth(rows) > data.size())) {
+        *this = transpose();
+        return;
+    }
+    stats::Scope scope(stats::Op::Transpose, 0, 2 * rows * columns * sizeof(float));
+    if (isEmpty()) {
+        std::swap(rows, columns);
+        ld = paddedWidth(columns);
+        return;
+    }
+    if (rows == columns) {
+        transposeSquareInPlace(view());
+        return;
+    }
+    cachedLU.reset();
+    float* p = data.data();
+    const size_t newLd = paddedWidth(rows);
+
+    // Squeeze out the row padding, permute, then spread the new rows out to
+    // their padded width, last row first since rows only move right
+    for (size_t r = 1; r < rows; ++r) {
+        std::memmove(p + r * columns, p + r * ld, columns * sizeof(float));
+    }
+    transposePackedInPlace(p, rows, columns);
+    for (size_t r = columns; r-- > 0;) {
+        std::memmove(p + r * newLd, p + r * rows, rows * sizeof(float));
+        std::fill(p + r * newLd + rows, p + (r + 1) * newLd, 0.0f);
+    }
+
+    std::swap(rows, columns);
+    ld = newLd;
+}
+
+Matrix Matrix::add(const Matrix& other) const {
+    if (rows != other.rows || columns != other.columns) {
+        std::cerr << "Error: Matrices must have the same dimensions to be added.\n";
+        return Matrix(); // Return an empty matrix
+    }
+
+    stats::Scope scope(stats::Op::Add, rows * columns, 3 * rows * columns * sizeof(float));
+    Matrix result(name, rows, columns);
+    ConstFloatView left = view();
+    ConstFloatView right = other.view();
+    FloatView sum = result.view();
+
+    parallelRange(rows, columns, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const float* a = left.row(i).data;
+            const float* b = right.row(i).data;
+            float* out = sum.row(i).data;
+            for (size_t j = 0; j < columns; ++j) {
+                out[j] = a[j] + b[j];
+            }
+        }
+    });
+
+
+    return result;
+}
+
+bool Matrix::isEmpty() const {
+    return rows == 0 || columns == 0;
+}
+
+Matrix Matrix::multiply(const Matrix& other) const {
+    if (columns != other.rows) {
+        std::cerr << "Error: Number of columns in the first matrix must be equal to the number of rows in the second matrix.\n";
+        return Matrix(); // Return an empty matrix
+    }
+
+    stats::Scope scope(stats::Op::Multiply, 2 * rows * columns * other.columns,
+                       (rows * columns + other.rows * other.columns + rows * other.columns) * sizeof(float));
+    Matrix result(name, rows, other.columns);
+    multiplyInto(view(), other.view(), result.view());
+
+    return result;
+}
+
+Matrix Matrix::duplicate(const std::string& newName) const {
+    stats::Scope scope(stats::Op::Duplicate);
+    Matrix duplicated(newName, 0, 0);
+    duplicated.rows = rows;
+    duplicated.columns = columns;
+    duplicated.ld = ld;
+    duplicated.data = data; // Shared until either side is written
+    duplicated.cachedLU = cachedLU; // Factors are immutable, so both can share them
+    return duplicated;
+}
+
+// PLU factorization with partial pivoting: P * A = L * U, with L unit lower
+// triangular and U upper triangular, both packed into one matrix. Columns
+// whose best pivot is negligible are skipped, so rectangular and singular
+// inputs still factor and report their rank.
+class LUFactorization {
+public:
+    explicit LUFactorization(ConstFloatView a);
+
+    size_t rank() const { return rankValue; }
+    bool isSingular() const { return lu.isEmpty() || rows != columns || rankValue < rows; }
+    double determinant() const;
+
+    // Solve A * x = b for every column of b in O(n^2) each. Returns false if
+    // A is not square and non-singular.
+    bool solve(ConstFloatView b, FloatView x) const;
+    Matrix solve(const Matrix& b) const;
+    Matrix inverse() const;
+
+    // Row i of P * A is row permutation()[i] of A
+    const std::vector<size_t>& permutation() const { return perm; }
+    ConstFloatView factors() const { return lu.view(); }
+
+private:
+    Matrix lu;
+    std::vector<size_t> perm;
+    size_t rows;
+    size_t columns;
+    size_t rankValue = 0;
+    int permutationSign = 1;
+};
+
+LUFactorization::LUFactorization(ConstFloatView a)
+    : lu("LU", a.rows, a.columns), perm(a.rows), rows(a.rows), columns(a.columns) {
+    FloatView m = lu.view();
+    float maxAbs = 0.0f;
+    for (size_t i = 0; i < rows; ++i) {
+        perm[i] = i;
+        for (size_t j = 0; j < columns; ++j) {
+            m(i, j) = a(i, j);
+            maxAbs = std::max(maxAbs, std::fabs(a(i, j)));
+        }
+    }
+    // Pivots this small relative to the matrix are treated as zero
+    const float tolerance = maxAbs * static_cast<float>(std::max(rows, columns)) * std::numeric_limits<float>::epsilon();
+
+    size_t r = 0;
+    for (size_t col = 0; col < columns && r < rows; ++col) {
+        // Choose the largest remaining entry in this column as the pivot
+        size_t pivotRow = r;
+        for (size_t i = r + 1; i < rows; ++i) {
+            if (std::fabs(m(i, col)) > std::fabs(m(pivotRow, col))) {
+                pivotRow = i;
+            }
+        }
+        if (std::fabs(m(pivotRow, col)) <= tolerance) {
+            continue;
+        }
+        if (pivotRow != r) {
+            ::swapRows(m.row(pivotRow), m.row(r));
+            std::swap(perm[pivotRow], perm[r]);
+            permutationSign = -permutationSign;
+        }
+
+        // Store the multipliers in L and update the trailing rows
+        float pivot = m(r, col);
+        ConstFloatView pivotTail = m.block(r, col + 1, 1, columns - col - 1);
+        for (size_t i = r + 1; i < rows; ++i) {
+            float factor = m(i, col) / pivot;
+            m(i, col) = factor;
+            if (factor != 0.0f) {
+                addScaledRow(-factor, pivotTail, m.block(i, col + 1, 1, columns - col - 1));
+            }
+        }
+        ++r;
+    }
+    rankValue = r;
+}
+
+double LUFactorization::determinant() const {
+    if (rows != columns) {
+        return 0.0;
+    }
+    if (rankValue < rows) {
+        return 0.0;
+    }
+    ConstFloatView m = lu.view();
+    double det = permutationSign;
+    for (size_t i = 0; i < rows; ++i) {
+        det *= m(i, i);
+    }
+    return det;
+}
+
+bool LUFactorization::solve(ConstFloatView b, FloatView x) const {
+    if (isSingular() || b.rows != rows || x.rows != rows || x.columns != b.columns) {
+        return false;
+    }
+    stats::Scope scope(stats::Op::LUSolve, 2 * rows * rows * b.columns, (rows * rows + 2 * rows * b.columns) * sizeof(float));
+    ConstFloatView m = lu.view();
+    const size_t n = rows;
+
+    // x = P * b
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j < b.columns; ++j) {
+            x(i, j) = b(perm[i], j);
+        }
+    }
+    // Forward substitution with unit L, a whole row of right-hand sides at a time
+    for (size_t i = 1; i < n; ++i) {
+        for (size_t k = 0; k < i; ++k) {
+            float factor = m(i, k);
+            if (factor != 0.0f) {
+                addScaledRow(-factor, x.row(k), x.row(i));
+            }
+        }
+    }
+    // Back substitution with U
+    for (size_t i = n; i-- > 0;) {
+        for (size_t k = i + 1; k < n; ++k) {
+            float factor = m(i, k);
+            if (factor != 0.0f) {
+                addScaledRow(-factor, x.row(k), x.row(i));
+            }
+        }
+        scaleRow(1.0f / m(i, i), x.row(i));
+    }
+    return true;
+}
+
+Matrix LUFactorization::solve(const Matrix& b) const {
+    ConstFloatView rhs = b.view();
+    Matrix x(b.getName(), rhs.rows, rhs.columns);
+    if (!solve(rhs, x.view())) {
+        return Matrix(); // Return an empty matrix
+    }
+    return x;
+}
+
+Matrix LUFactorization::inverse() const {
+    Matrix identity("I", rows, rows);
+    for (size_t i = 0; i < rows; ++i) {
+        identity.setElement(i, i, 1.0f);
+    }
+    return solve(identity);
+}
+
+std::shared_ptr<const LUFactorization> Matrix::factorization() const {
+    if (!cachedLU) {
+        stats::Scope scope(stats::Op::Factor, stats::factorFlops(rows, columns), 2 * rows * columns * sizeof(float));
+        cachedLU = std::make_shared<const LUFactorization>(view());
+    }
+    return cachedLU;
+}
+
+void reportSolutionKind(const std::string& name, SolutionKind kind) {
+    std::cout << "System " << name;
+    switch (kind) {
+        case SolutionKind::Unique:
+            std::cout << " has a unique solution.\n";
+            break;
+        case SolutionKind::Infinite:
+            std::cout << " has infinitely many solutions.\n";
+            break;
+        case SolutionKind::Inconsistent:
+            std::cout << " is inconsistent.\n";
+            break;
+    }
+}
+
+// Dense matrices of any element type
+//
+// Matrix is float only: its GEMM kernels, .mtxb files and cached LU factors
+// are all built around 32-bit floats. BasicMatrix<T> runs the same templated
+// view kernels and blocked RREF on double, std::complex or any other type
+// with the usual arithmetic, and converts to and from Matrix at the edges.
+template <typename T>
+class BasicMatrix {
+public:
+    BasicMatrix() = default;
+    BasicMatrix(const std::string& name, size_t rws, size_t clmns)
+        : name(name), rows(rws), columns(clmns), values(rws * clmns, T(0)) {}
+
+    static BasicMatrix fromMatrix(const Matrix& m) {
+        ConstFloatView src = m.view();
+        BasicMatrix result(m.getName(), src.rows, src.columns);
+        for (size_t r = 0; r < src.rows; ++r) {
+            for (size_t c = 0; c < src.columns; ++c) {
+                result.values[r * src.columns + c] = T(src(r, c));
+            }
+        }
+        return result;
+    }
+
+    // Rounds every element to float; only real element types convert
+    Matrix toMatrix() const {
+        Matrix result(name, rows, columns);
+        FloatView dst = result.view();
+        for (size_t r = 0; r < rows; ++r) {
+            for (size_t c = 0; c < columns; ++c) {
+                dst(r, c) = static_cast<float>(values[r * columns + c]);
+            }
+        }
+        return result;
+    }
+
+    MatrixView<T> view() {
+        return {values.data(), rows, columns, static_cast<ptrdiff_t>(columns), 1};
+    }
+    MatrixView<const T> view() const {
+        return {values.data(), rows, columns, static_cast<ptrdiff_t>(columns), 1};
+    }
+
+    T getElement(size_t row, size_t col) const { return values[row * columns + col]; }
+    void setElement(size_t row, size_t col, const T& value) { values[row * columns + col] = value; }
+    bool isEmpty() const { return rows == 0 || columns == 0; }
+    size_t rowCount() const { return rows; }
+    size_t columnCount() const { return columns; }
+    std::string getName() const { return name; }
+    void setName(const std::string& newName) { name = newName; }
+
+    BasicMatrix transpose() const {
+        BasicMatrix result(name, columns, rows);
+        transposeInto<T>(view(), result.view());
+        return result;
+    }
+
+    BasicMatrix add(const BasicMatrix& other) const {
+        if (rows != other.rows || columns != other.columns) {
+            std::cerr << "Error: Matrices must have the same dimensions to be added.\n";
+            return BasicMatrix(); // Return an empty matrix
+        }
+        BasicMatrix result(name, rows, columns);
+        for (size_t i = 0; i < values.size(); ++i) {
+            result.values[i] = values[i] + other.values[i];
+        }
+        return result;
+    }
+
+    BasicMatrix multiply(const BasicMatrix& other) const {
+        if (columns != other.rows) {
+            std::cerr << "Error: Number of columns in the first matrix must be equal to the number of rows in the second matrix.\n";
+            return BasicMatrix(); // Return an empty matrix
+        }
+        BasicMatrix result(name, rows, other.columns);
+        multiplyInto<T>(view(), other.view(), result.view());
+        return result;
+    }
+
+    // Untraced blocked reduction to RREF in T's precision
+    SolutionKind fastSolve() { return reduceToRrefBlocked(view()); }
+
+    void print() const {
+        std::cout << "Matrix " << name << ":\n";
+        for (size_t r = 0; r < rows; ++r) {
+            for (size_t c = 0; c < columns; ++c) {
+                std::cout << values[r * columns + c] << "\t";
+            }
+            std::cout << std::endl;
+        }
+    }
+
+private:
+    std::string name;
+    size_t rows = 0;
+    size_t columns = 0;
+    std::vector<T, AlignedAllocator<T>> values;
+};
+
+// |x| usable in constant expressions for real types
+template <typename T>
+constexpr T fixedMagnitude(const T& x) {
+    return x < T(0) ? -x : x;
+}
+
+template <typename T>
+T fixedMagnitude(const std::complex<T>& x) {
+    return std::abs(x);
+}
+
+// Fixed-size matrices
+//
+// The dimensions are template parameters and the elements live inline, so a
+// 3x3 or 4x4 transform never touches the heap and every loop has a trip count
+// the compiler knows and can fully unroll. Everything but view() is
+// constexpr, so products of constant matrices can fold away entirely.
+template <typename T, size_t R, size_t C>
+struct FixedMatrix {
+    T values[R][C] = {};
+
+    static constexpr size_t rowCount() { return R; }
+    static constexpr size_t columnCount() { return C; }
+
+    static constexpr FixedMatrix identity() {
+        static_assert(R == C, "identity() needs a square matrix");
+        FixedMatrix result{};
+        for (size_t i = 0; i < R; ++i) {
+            result.values[i][i] = T(1);
+        }
+        return result;
+    }
+
+    constexpr T& operator()(size_t r, size_t c) { return values[r][c]; }
+    constexpr const T& operator()(size_t r, size_t c) const { return values[r][c]; }
+
+    // Hands the storage to the generic view kernels
+    MatrixView<T> view() { return {&values[0][0], R, C, static_cast<ptrdiff_t>(C), 1}; }
+    MatrixView<const T> view() const { return {&values[0][0], R, C, static_cast<ptrdiff_t>(C), 1}; }
+
+    constexpr FixedMatrix<T, C, R> transpose() const {
+        FixedMatrix<T, C, R> result{};
+        for (size_t r = 0; r < R; ++r) {
+            for (size_t c = 0; c < C; ++c) {
+                result.values[c][r] = values[r][c];
+            }
+        }
+        return result;
+    }
+
+    constexpr FixedMatrix operator+(const FixedMatrix& other) const {
+        FixedMatrix result{};
+        for (size_t r = 0; r < R; ++r) {
+            for (size_t c = 0; c < C; ++c) {
+                result.values[r][c] = values[r][c] + other.values[r][c];
+            }
+        }
+        return result;
+    }
+
+    constexpr FixedMatrix operator-(const FixedMatrix& other) const {
+        return *this + other * T(-1);
+    }
+
+    constexpr FixedMatrix operator*(const T& scalar) const {
+        FixedMatrix result{};
+        for (size_t r = 0; r < R; ++r) {
+            for (size_t c = 0; c < C; ++c) {
+                result.values[r][c] = values[r][c] * scalar;
+            }
+        }
+        return result;
+    }
+
+    template <size_t K>
+    constexpr FixedMatrix<T, R, K> operator*(const FixedMatrix<T, C, K>& other) const {
+        FixedMatrix<T, R, K> result{};
+        for (size_t i = 0; i < R; ++i) {
+            for (size_t k = 0; k < C; ++k) {
+                for (size_t j = 0; j < K; ++j) {
+                    result.values[i][j] += values[i][k] * other.values[k][j];
+                }
+            }
+        }
+        return result;
+    }
+
+    constexpr bool operator==(const FixedMatrix& other) const {
+        for (size_t r = 0; r < R; ++r) {
+            for (size_t c = 0; c < C; ++c) {
+                if (!(values[r][c] == other.values[r][c])) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+    constexpr bool operator!=(const FixedMatrix& other) const { return !(*this == other); }
+
+    // x = this^-1 * b by Gaussian elimination with partial pivoting. Returns
+    // false, leaving x untouched, if the matrix is singular.
+    template <size_t K>
+    constexpr bool solve(const FixedMatrix<T, R, K>& b, FixedMatrix<T, R, K>& x) const {
+        static_assert(R == C, "solve() needs a square matrix");
+        FixedMatrix a = *this;
+        FixedMatrix<T, R, K> rhs = b;
+        for (size_t col = 0; col < C; ++col) {
+            size_t pivotRow = col;
+            for (size_t i = col + 1; i < R; ++i) {
+                if (fixedMagnitude(a.values[i][col]) > fixedMagnitude(a.values[pivotRow][col])) {
+                    pivotRow = i;
+                }
+            }
+            if (a.values[pivotRow][col] == T(0)) {
+                return false;
+            }
+            if (pivotRow != col) {
+                for (size_t c = 0; c < C; ++c) {
+                    T t = a.values[col][c];
+                    a.values[col][c] = a.values[pivotRow][c];
+                    a.values[pivotRow][c] = t;
+                }
+                for (size_t c = 0; c < K; ++c) {
+                    T t = rhs.values[col][c];
+                    rhs.values[col][c] = rhs.values[pivotRow][c];
+                    rhs.values[pivotRow][c] = t;
+                }
+            }
+            for (size_t i = col + 1; i < R; ++i) {
+                T factor = a.values[i][col] / a.values[col][col];
+                for (size_t c = col; c < C; ++c) {
+                    a.values[i][c] -= factor * a.values[col][c];
+                }
+                for (size_t c = 0; c < K; ++c) {
+                    rhs.values[i][c] -= factor * rhs.values[col][c];
+                }
+            }
+        }
+        // Back substitution
+        for (size_t i = R; i-- > 0;) {
+            for (size_t c = 0; c < K; ++c) {
+                T sum = rhs.values[i][c];
+                for (size_t k = i + 1; k < C; ++k) {
+                    sum -= a.values[i][k] * rhs.values[k][c];
+                }
+                rhs.values[i][c] = sum / a.values[i][i];
+            }
+        }
+        x = rhs;
+        return true;
+    }
+
+    constexpr bool inverse(FixedMatrix& result) const {
+        return solve(identity(), result);
+    }
+};
+
+template <typename T, size_t R, size_t C>
+constexpr FixedMatrix<T, R, C> operator*(const T& scalar, const FixedMatrix<T, R, C>& m) {
+    return m * scalar;
+}
+
+template <typename T>
+using Matrix3 = FixedMatrix<T, 3, 3>;
+template <typename T>
+using Matrix4 = FixedMatrix<T, 4, 4>;
+
+// The fixed-size operations have to stay usable at compile time
+static_assert((FixedMatrix<int, 2, 2>{{{1, 2}, {3, 4}}} * FixedMatrix<int, 2, 2>::identity()).transpose()(0, 1) == 3,
+              "FixedMatrix arithmetic is no longer constexpr");
+
+// Batches of small matrices
+//
+// MatrixBatch holds count matrices of one shape in structure-of-arrays order:
+// element (r, c) of every matrix is one contiguous, cache-line aligned run of
+// lanes, lane i belonging to matrix i. Every kernel loops over a fixed-width
+// tile of lanes innermost, so the compiler vectorizes across matrices (16 per
+// AVX-512 register) with no shuffles whatever the matrix size, and the tiles
+// are spread over the thread pool. This is meant for thousands of 3x3 to 16x16
+// problems, where handling each matrix on its own costs far more than the
+// arithmetic.
+
+// Lanes each kernel works through at a time; a 16x16 solve keeps its tile
+// in L2. Batches are padded to whole tiles so no kernel needs a remainder loop.
+constexpr size_t kBatchTile = 64;
+
+class MatrixBatch {
+public:
+    MatrixBatch() = default;
+    MatrixBatch(size_t count, size_t rws, size_t clmns)
+        : count(count), rows(rws), columns(clmns), stride(paddedLanes(count)), data(rws * clmns * paddedLanes(count)) {}
+
+    size_t size() const { return count; }
+    size_t rowCount() const { return rows; }
+    size_t columnCount() const { return columns; }
+    bool isEmpty() const { return count == 0 || rows == 0 || columns == 0; }
+
+    // Element (r, c) of every matrix in the batch
+    float* lanes(size_t r, size_t c) { return data.data() + (r * columns + c) * stride; }
+    const float* lanes(size_t r, size_t c) const { return data.data() + (r * columns + c) * stride; }
+
+    float getElement(size_t index, size_t r, size_t c) const { return lanes(r, c)[index]; }
+    void setElement(size_t index, size_t r, size_t c, float value) { lanes(r, c)[index] = value; }
+
+    // Copy matrix index in from a view of the batch's shape (a Matrix,
+    // FixedMatrix or block of either), or out to a Matrix
+    void setMatrix(size_t index, ConstFloatView m);
+    Matrix getMatrix(size_t index, const std::string& name) const;
+
+    MatrixBatch transpose() const;
+    MatrixBatch multiply(const MatrixBatch& other) const; // Matrix i times matrix i
+
+    // Solve A_i X_i = B_i for every square A_i in this batch, by LU with
+    // partial pivoting chosen separately for each matrix. A singular system
+    // gets a NaN solution and, if singular is given, a nonzero flag in it.
+    MatrixBatch solve(const MatrixBatch& rhs, std::vector<char>* singular = nullptr) const;
+
+private:
+    size_t count = 0;
+    size_t rows = 0;
+    size_t columns = 0;
+    size_t stride = 0; // Lanes per element, padded to a whole tile
+    MatrixBuffer data;
+
+    static size_t paddedLanes(size_t count) { return (count + kBatchTile - 1) / kBatchTile * kBatchTile; }
+};
+
+void MatrixBatch::setMatrix(size_t index, ConstFloatView m) {
+    if (index >= count || m.rows != rows || m.columns != columns) {
+        std::cerr << "Error: Matrix does not fit batch entry " << index + 1 << ".\n";
+        return;
+    }
+    for (size_t r = 0; r < rows; ++r) {
+        for (size_t c = 0; c < columns; ++c) {
+            lanes(r, c)[index] = m(r, c);
+        }
+    }
+}
+
+Matrix MatrixBatch::getMatrix(size_t index, const std::string& name) const {
+    if (index >= count) {
+        std::cerr << "Error: Batch entry " << index + 1 << " is out of bounds.\n";
+        return Matrix();
+    }
+    Matrix m(name, rows, columns);
+    FloatView v = m.view();
+    for (size_t r = 0; r < rows; ++r) {
+        for (size_t c = 0; c < columns; ++c) {
+            v(r, c) = lanes(r, c)[index];
+        }
+    }
+    return m;
+}
+
+MatrixBatch MatrixBatch::transpose() const {
+    stats::Scope scope(stats::Op::BatchTranspose, 0, 2 * count * rows * columns * sizeof(float));
+    MatrixBatch result(count, columns, rows);
+    const float* src = data.data();
+    float* dst = result.data.data();
+    // Whole runs of lanes move; nothing is shuffled within a run
+    parallelRange(rows * columns, stride, [&](size_t begin, size_t end) {
+        for (size_t e = begin; e < end; ++e) {
+            size_t r = e / columns, c = e % columns;
+            std::copy(src + e * stride, src + (e + 1) * stride, dst + (c * rows + r) * stride);
+        }
+    });
+    return result;
+}
+
+MatrixBatch MatrixBatch::multiply(const MatrixBatch& other) const {
+    if (count != other.count || columns != other.rows) {
+        std::cerr << "Error: Batches must hold the same number of matrices, and the number of columns in the first must "
+                     "equal the number of rows in the second.\n";
+        return MatrixBatch();
+    }
+    const size_t n = other.columns;
+    stats::Scope scope(stats::Op::BatchMultiply, 2 * count * rows * columns * n,
+                       count * (rows * columns + columns * n + rows * n) * sizeof(float));
+    MatrixBatch result(count, rows, n);
+    const float* a = data.data();
+    const float* b = other.data.data();
+    float* c = result.data.data();
+    parallelRange(stride / kBatchTile, kBatchTile * rows * columns * n, [&](size_t begin, size_t end) {
+        float sum[kBatchTile];
+        for (size_t t = begin; t < end; ++t) {
+            const size_t first = t * kBatchTile;
+            for (size_t i = 0; i < rows; ++i) {
+                for (size_t j = 0; j < n; ++j) {
+                    std::fill(sum, sum + kBatchTile, 0.0f);
+                    for (size_t k = 0; k < columns; ++k) {
+                        const float* x = a + (i * columns + k) * stride + first;
+                        const float* y = b + (k * n + j) * stride + first;
+                        for (size_t l = 0; l < kBatchTile; ++l) {
+                            sum[l] += x[l] * y[l];
+                        }
+                    }
+                    std::copy(sum, sum + kBatchTile, c + (i * n + j) * stride + first);
+                }
+            }
+        }
+    });
+    return result;
+}
+
+MatrixBatch MatrixBatch::solve(const MatrixBatch& rhs, std::vector<char>* singular) const {
+    if (rows != columns || rhs.count != count || rhs.rows != rows) {
+        std::cerr << "Error: Batch solve needs square matrices and a right-hand side with as many matrices and rows.\n";
+        return MatrixBatch();
+    }
+    const size_t n = rows, m = rhs.columns;
+    stats::Scope scope(stats::Op::BatchSolve, count * (2 * n * n * n / 3 + 2 * n * n * m),
+                       count * (n * n + 2 * n * m) * sizeof(float));
+    MatrixBatch result(count, n, m);
+    if (singular) {
+        singular->assign(count, 0);
+    }
+    const float* aIn = data.data();
+    const float* bIn = rhs.data.data();
+    float* xOut = result.data.data();
+
+    parallelRange(stride / kBatchTile, kBatchTile * n * n * (n + m), [&](size_t begin, size_t end) {
+        // Element (r, c) of the tile's A is a[(r * n + c) * kBatchTile + lane]; likewise b
+        std::vector<float> a(n * n * kBatchTile), b(n * m * kBatchTile);
+        float maxAbs[kBatchTile], best[kBatchTile];
+        int32_t pivot[kBatchTile];
+        char bad[kBatchTile];
+        auto at = [&](size_t r, size_t c) { return &a[(r * n + c) * kBatchTile]; };
+        auto rhsAt = [&](size_t r, size_t c) { return &b[(r * m + c) * kBatchTile]; };
+
+        for (size_t t = begin; t < end; ++t) {
+            const size_t first = t * kBatchTile;
+            for (size_t e = 0; e < n * n; ++e) {
+                std::copy(aIn + e * stride + first, aIn + e * stride + first + kBatchTile, &a[e * kBatchTile]);
+            }
+            for (size_t e = 0; e < n * m; ++e) {
+                std::copy(bIn + e * stride + first, bIn + e * stride + first + kBatchTile, &b[e * kBatchTile]);
+            }
+
+            // Pivots this small relative to their matrix count as zero, as in LUFactorization
+            std::fill(maxAbs, maxAbs + kBatchTile, 0.0f);
+            for (size_t e = 0; e < n * n; ++e) {
+                const float* v = &a[e * kBatchTile];
+                for (size_t l = 0; l < kBatchTile; ++l) {
+                    maxAbs[l] = std::max(maxAbs[l], std::fabs(v[l]));
+                }
+            }
+            const float scale = static_cast<float>(n) * std::numeric_limits<float>::epsilon();
+            std::fill(bad, bad + kBatchTile, 0);
+
+            for (size_t k = 0; k < n; ++k) {
+                // Each lane picks its own pivot row
+                const float* diagonal = at(k, k);
+                for (size_t l = 0; l < kBatchTile; ++l) {
+                    best[l] = std::fabs(diagonal[l]);
+                    pivot[l] = static_cast<int32_t>(k);
+                }
+                for (size_t i = k + 1; i < n; ++i) {
+                    const float* v = at(i, k);
+                    for (size_t l = 0; l < kBatchTile; ++l) {
+                        bool larger = std::fabs(v[l]) > best[l];
+                        best[l] = larger ? std::fabs(v[l]) : best[l];
+                        pivot[l] = larger ? static_cast<int32_t>(i) : pivot[l];
+                    }
+                }
+                for (size_t l = 0; l < kBatchTile; ++l) {
+                    bad[l] |= best[l] <= maxAbs[l] * scale;
+                }
+
+                // Swap row k with each lane's pivot row as a masked exchange,
+                // so no lane has to gather from a different row. Rows no lane
+                // pivots on are skipped.
+                for (size_t i = k + 1; i < n; ++i) {
+                    if (std::find(pivot, pivot + kBatchTile, static_cast<int32_t>(i)) == pivot + kBatchTile) {
+                        continue;
+                    }
+                    auto exchange = [&](float* x, float* y) {
+                        for (size_t l = 0; l < kBatchTile; ++l) {
+                            bool take = pivot[l] == static_cast<int32_t>(i);
+                            float keep = x[l];
+                            x[l] = take ? y[l] : x[l];
+                            y[l] = take ? keep : y[l];
+                        }
+                    };
+                    for (size_t j = k; j < n; ++j) {
+                        exchange(at(k, j), at(i, j));
+                    }
+                    for (size_t j = 0; j < m; ++j) {
+                        exchange(rhsAt(k, j), rhsAt(i, j));
+                    }
+                }
+
+                // Eliminate below the pivot
+                for (size_t i = k + 1; i < n; ++i) {
+                    float* factor = at(i, k);
+                    for (size_t l = 0; l < kBatchTile; ++l) {
+                        factor[l] /= diagonal[l];
+                    }
+                    for (size_t j = k + 1; j < n; ++j) {
+                        float* target = at(i, j);
+                        const float* source = at(k, j);
+                        for (size_t l = 0; l < kBatchTile; ++l) {
+                            target[l] -= factor[l] * source[l];
+                        }
+                    }
+                    for (size_t j = 0; j < m; ++j) {
+                        float* target = rhsAt(i, j);
+                        const float* source = rhsAt(k, j);
+                        for (size_t l = 0; l < kBatchTile; ++l) {
+                            target[l] -= factor[l] * source[l];
+                        }
+                    }
+                }
+            }
+
+            // Back substitution, in place in b
+            for (size_t i = n; i-- > 0;) {
+                for (size_t j = 0; j < m; ++j) {
+                    float* x = rhsAt(i, j);
+                    for (size_t k = i + 1; k < n; ++k) {
+                        const float* u = at(i, k);
+                        const float* y = rhsAt(k, j);
+                        for (size_t l = 0; l < kBatchTile; ++l) {
+                            x[l] -= u[l] * y[l];
+                        }
+                    }
+                    const float* d = at(i, i);
+                    for (size_t l = 0; l < kBatchTile; ++l) {
+                        x[l] = bad[l] ? std::numeric_limits<float>::quiet_NaN() : x[l] / d[l];
+                    }
+                }
+            }
+
+            for (size_t e = 0; e < n * m; ++e) {
+                std::copy(&b[e * kBatchTile], &b[(e + 1) * kBatchTile], xOut + e * stride + first);
+            }
+            if (singular) {
+                // The padding lanes past count are all zero, so they come out singular; drop them
+                const size_t width = std::min(kBatchTile, count - first);
+                std::copy(bad, bad + width, singular->begin() + static_cast<ptrdiff_t>(first));
+            }
+        }
+    });
+    return result;
+}
+
+// Exact rational arithmetic
+//
+// Rational keeps a reduced numerator/denominator pair inline as 64-bit
+// integers, which is all most row operations ever need. Every small operation
+// is overflow checked; on overflow the value is promoted to a BigInt pair and
+// demoted again as soon as a result fits. Denominators are always positive
+// and coprime with the numerator, so equality is plain comparison.
+
+#if defined(__GNUC__)
+inline bool checkedAdd(int64_t a, int64_t b, int64_t& out) { return !__builtin_add_overflow(a, b, &out); }
+inline bool checkedSub(int64_t a, int64_t b, int64_t& out) { return !__builtin_sub_overflow(a, b, &out); }
+inline bool checkedMul(int64_t a, int64_t b, int64_t& out) { return !__builtin_mul_overflow(a, b, &out); }
+inline int trailingZeros(uint64_t x) { return __builtin_ctzll(x); }
+inline int leadingZeros(uint32_t x) { return __builtin_clz(x); }
+#else
+inline bool checkedAdd(int64_t a, int64_t b, int64_t& out) {
+    if ((b > 0 && a > INT64_MAX - b) || (b < 0 && a < INT64_MIN - b)) {
+        return false;
+    }
+    out = a + b;
+    return true;
+}
+inline bool checkedSub(int64_t a, int64_t b, int64_t& out) {
+    if ((b < 0 && a > INT64_MAX + b) || (b > 0 && a < INT64_MIN + b)) {
+        return false;
+    }
+    out = a - b;
+    return true;
+}
+inline bool checkedMul(int64_t a, int64_t b, int64_t& out) {
+    if (a > 0 ? (b > 0 ? a > INT64_MAX / b : b < INT64_MIN / a)
+              : (b > 0 ? a < INT64_MIN / b : a != 0 && b < INT64_MAX / a)) {
+        return false;
+    }
+    out = a * b;
+    return true;
+}
+inline int trailingZeros(uint64_t x) {
+    int n = 0;
+    for (; (x & 1) == 0; x >>= 1) {
+        ++n;
+    }
+    return n;
+}
+inline int leadingZeros(uint32_t x) {
+    int n = 0;
+    for (; (x & 0x80000000u) == 0; x <<= 1) {
+        ++n;
+    }
+    return n;
+}
+#endif
+
+// Binary GCD: shifts and subtractions only, no divisions
+inline uint64_t gcd64(uint64_t a, uint64_t b) {
+    if (a == 0 || b == 0) {
+        return a | b;
+    }
+    int shift = trailingZeros(a | b);
+    a >>= trailingZeros(a);
+    do {
+        b >>= trailingZeros(b);
+        if (a > b) {
+            std::swap(a, b);
+        }
+        b -= a;
+    } while (b != 0);
+    return a << shift;
+}
+
+// Arbitrary-precision signed integer, sign and magnitude with 32-bit limbs
+// stored least significant first and no leading zero limbs
+class BigInt {
+public:
+    BigInt() = default;
+    BigInt(int64_t value) : negative(value < 0) {
+        uint64_t magnitude = value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+        while (magnitude != 0) {
+            limbs.push_back(static_cast<uint32_t>(magnitude));
+            magnitude >>= 32;
+        }
+    }
+
+    static BigInt powerOfTwo(size_t exponent) {
+        BigInt result;
+        result.limbs.assign(exponent / 32 + 1, 0);
+        result.limbs.back() = 1u << (exponent % 32);
+        return result;
+    }
+
+    bool isZero() const { return limbs.empty(); }
+    bool isNegative() const { return negative; }
+
+    // True if the value fits in an int64_t other than INT64_MIN
+    bool fitsInt64() const {
+        return limbs.size() < 2 || (limbs.size() == 2 && limbs[1] < 0x80000000u);
+    }
+    int64_t toInt64() const {
+        uint64_t magnitude = 0;
+        for (size_t i = limbs.size(); i-- > 0;) {
+            magnitude = (magnitude << 32) | limbs[i];
+        }
+        return negative ? -static_cast<int64_t>(magnitude) : static_cast<int64_t>(magnitude);
+    }
+
+    // Approximately this = mantissa * 2^exponent, keeping the top 96 bits
+    double toDouble(long& exponent) const {
+        double mantissa = 0.0;
+        size_t first = limbs.size() > 3 ? limbs.size() - 3 : 0;
+        for (size_t i = limbs.size(); i-- > first;) {
+            mantissa = mantissa * 4294967296.0 + limbs[i];
+        }
+        exponent = static_cast<long>(first * 32);
+        return negative ? -mantissa : mantissa;
+    }
+
+    BigInt operator-() const {
+        BigInt result = *this;
+        result.negative = !isZero() && !negative;
+        return result;
+    }
+
+    friend BigInt operator+(const BigInt& a, const BigInt& b) {
+        if (a.negative == b.negative) {
+            return make(addMagnitudes(a.limbs, b.limbs), a.negative);
+        }
+        if (compareMagnitudes(a.limbs, b.limbs) >= 0) {
+            return make(subtractMagnitudes(a.limbs, b.limbs), a.negative);
+        }
+        return make(subtractMagnitudes(b.limbs, a.limbs), b.negative);
+    }
+
+    friend BigInt operator-(const BigInt& a, const BigInt& b) { return a + -b; }
+
+    friend BigInt operator*(const BigInt& a, const BigInt& b) {
+        if (a.isZero() || b.isZero()) {
+            return BigInt();
+        }
+        std::vector<uint32_t> product(a.limbs.size() + b.limbs.size(), 0);
+        for (size_t i = 0; i < a.limbs.size(); ++i) {
+            uint64_t carry = 0;
+            for (size_t j = 0; j < b.limbs.size(); ++j) {
+                uint64_t t = static_cast<uint64_t>(a.limbs[i]) * b.limbs[j] + product[i + j] + carry;
+                product[i + j] = static_cast<uint32_t>(t);
+                carry = t >> 32;
+            }
+            product[i + b.limbs.size()] = static_cast<uint32_t>(carry);
+        }
+        return make(std::move(product), a.negative != b.negative);
+    }
+
+    // Truncating division: a = quotient * b + remainder, remainder takes a's sign
+    static void divide(const BigInt& a, const BigInt& b, BigInt& quotient, BigInt& remainder) {
+        std::vector<uint32_t> q, r;
+        divideMagnitudes(a.limbs, b.limbs, q, r);
+        quotient = make(std::move(q), a.negative != b.negative);
+        remainder = make(std::move(r), a.negative);
+    }
+
+    friend BigInt operator/(const BigInt& a, const BigInt& b) {
+        BigInt q, r;
+        divide(a, b, q, r);
+        return q;
+    }
+
+    static BigInt gcd(BigInt a, BigInt b) {
+        a.negative = false;
+        b.negative = false;
+        while (!b.isZero()) {
+            if (a.fitsInt64() && b.fitsInt64()) {
+                return BigInt(static_cast<int64_t>(gcd64(a.toInt64(), b.toInt64())));
+            }
+            BigInt q, r;
+            divide(a, b, q, r);
+            a = std::move(b);
+            b = std::move(r);
+        }
+        return a;
+    }
+
+    friend bool operator==(const BigInt& a, const BigInt& b) {
+        return a.negative == b.negative && a.limbs == b.limbs;
+    }
+    friend bool operator!=(const BigInt& a, const BigInt& b) { return !(a == b); }
+    friend bool operator<(const BigInt& a, const BigInt& b) {
+        if (a.negative != b.negative) {
+            return a.negative;
+        }
+        int c = compareMagnitudes(a.limbs, b.limbs);
+        return a.negative ? c > 0 : c < 0;
+    }
+
+    std::string toString() const {
+        if (isZero()) {
+            return "0";
+        }
+        // Peel off nine decimal digits at a time
+        std::vector<uint32_t> rest = limbs;
+        std::vector<uint32_t> chunks;
+        while (!rest.empty()) {
+            uint64_t remainder = 0;
+            for (size_t i = rest.size(); i-- > 0;) {
+                uint64_t t = (remainder << 32) | rest[i];
+                rest[i] = static_cast<uint32_t>(t / 1000000000u);
+                remainder = t % 1000000000u;
+            }
+            trim(rest);
+            chunks.push_back(static_cast<uint32_t>(remainder));
+        }
+        std::string text = negative ? "-" : "";
+        text += std::to_string(chunks.back());
+        for (size_t i = chunks.size() - 1; i-- > 0;) {
+            std::string digits = std::to_string(chunks[i]);
+            text += std::string(9 - digits.size(), '0') + digits;
+        }
+        return text;
+    }
+
+private:
+    bool negative = false;
+    std::vector<uint32_t> limbs;
+
+    static BigInt make(std::vector<uint32_t> limbs, bool negative) {
+        trim(limbs);
+        BigInt result;
+        result.negative = negative && !limbs.empty();
+        result.limbs = std::move(limbs);
+        return result;
+    }
+
+    static void trim(std::vector<uint32_t>& limbs) {
+        while (!limbs.empty() && limbs.back() == 0) {
+            limbs.pop_back();
+        }
+    }
+
+    static int compareMagnitudes(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b) {
+        if (a.size() != b.size()) {
+            return a.size() < b.size() ? -1 : 1;
+        }
+        for (size_t i = a.size(); i-- > 0;) {
+            if (a[i] != b[i]) {
+                return a[i] < b[i] ? -1 : 1;
+            }
+        }
+        return 0;
+    }
+
+    static std::vector<uint32_t> addMagnitudes(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b) {
+        const std::vector<uint32_t>& longer = a.size() >= b.size() ? a : b;
+        const std::vector<uint32_t>& shorter = a.size() >= b.size() ? b : a;
+        std::vector<uint32_t> sum(longer.size() + 1, 0);
+        uint64_t carry = 0;
+        for (size_t i = 0; i < longer.size(); ++i) {
+            uint64_t t = static_cast<uint64_t>(longer[i]) + (i < shorter.size() ? shorter[i] : 0) + carry;
+            sum[i] = static_cast<uint32_t>(t);
+            carry = t >> 32;
+        }
+        sum[longer.size()] = static_cast<uint32_t>(carry);
+        return sum;
+    }
+
+    // a - b for |a| >= |b|
+    static std::vector<uint32_t> subtractMagnitudes(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b) {
+        std::vector<uint32_t> difference(a.size(), 0);
+        int64_t borrow = 0;
+        for (size_t i = 0; i < a.size(); ++i) {
+            int64_t t = static_cast<int64_t>(a[i]) - (i < b.size() ? b[i] : 0) - borrow;
+            borrow = t < 0 ? 1 : 0;
+            difference[i] = static_cast<uint32_t>(t + (borrow << 32));
+        }
+        return difference;
+    }
+
+    // Knuth's algorithm D (TAOCP 4.3.1) on normalized 32-bit limbs
+    static void divideMagnitudes(const std::vector<uint32_t>& u, const std::vector<uint32_t>& v,
+                                 std::vector<uint32_t>& q, std::vector<uint32_t>& r) {
+        // Division by zero leaves everything in the remainder
+        if (v.empty() || compareMagnitudes(u, v) < 0) {
+            q.clear();
+            r = u;
+            return;
+        }
+        const uint64_t base = uint64_t(1) << 32;
+        if (v.size() == 1) {
+            q.assign(u.size(), 0);
+            uint64_t remainder = 0;
+            for (size_t i = u.size(); i-- > 0;) {
+                uint64_t t = (remainder << 32) | u[i];
+                q[i] = static_cast<uint32_t>(t / v[0]);
+                remainder = t % v[0];
+            }
+            r.assign(1, static_cast<uint32_t>(remainder));
+            trim(q);
+            trim(r);
+            return;
+        }
+
+        const size_t n = v.size();
+        const size_t m = u.size() - n;
+        const int shift = leadingZeros(v.back());
+        std::vector<uint32_t> vn(n), un(u.size() + 1);
+        for (size_t i = n - 1; i > 0; --i) {
+            vn[i] = (v[i] << shift) | (shift ? static_cast<uint32_t>(static_cast<uint64_t>(v[i - 1]) >> (32 - shift)) : 0);
+        }
+        vn[0] = v[0] << shift;
+        un[u.size()] = shift ? static_cast<uint32_t>(static_cast<uint64_t>(u.back()) >> (32 - shift)) : 0;
+        for (size_t i = u.size() - 1; i > 0; --i) {
+            un[i] = (u[i] << shift) | (shift ? static_cast<uint32_t>(static_cast<uint64_t>(u[i - 1]) >> (32 - shift)) : 0);
+        }
+        un[0] = u[0] << shift;
+
+        q.assign(m + 1, 0);
+        for (size_t j = m + 1; j-- > 0;) {
+            uint64_t top = (static_cast<uint64_t>(un[j + n]) << 32) | un[j + n - 1];
+            uint64_t qhat = top / vn[n - 1];
+            uint64_t rhat = top % vn[n - 1];
+            while (qhat >= base || qhat * vn[n - 2] > ((rhat << 32) | un[j + n - 2])) {
+                --qhat;
+                rhat += vn[n - 1];
+                if (rhat >= base) {
+                    break;
+                }
+            }
+            // un[j .. j+n] -= qhat * vn
+            int64_t borrow = 0;
+            uint64_t carry = 0;
+            for (size_t i = 0; i < n; ++i) {
+                uint64_t p = qhat * vn[i] + carry;
+                carry = p >> 32;
+                int64_t t = static_cast<int64_t>(un[i + j]) - borrow - static_cast<int64_t>(p & 0xFFFFFFFFu);
+                un[i + j] = static_cast<uint32_t>(t);
+                borrow = t < 0 ? 1 : 0;
+            }
+            int64_t t = static_cast<int64_t>(un[j + n]) - borrow - static_cast<int64_t>(carry);
+            un[j + n] = static_cast<uint32_t>(t);
+            if (t < 0) {
+                // qhat was one too large; add vn back
+                --qhat;
+                uint64_t c = 0;
+                for (size_t i = 0; i < n; ++i) {
+                    uint64_t s = static_cast<uint64_t>(un[i + j]) + vn[i] + c;
+                    un[i + j] = static_cast<uint32_t>(s);
+                    c = s >> 32;
+                }
+                un[j + n] = static_cast<uint32_t>(un[j + n] + c);
+            }
+            q[j] = static_cast<uint32_t>(qhat);
+        }
+
+        r.assign(n, 0);
+        for (size_t i = 0; i < n; ++i) {
+            r[i] = (un[i] >> shift) | (shift ? static_cast<uint32_t>(static_cast<uint64_t>(un[i + 1]) << (32 - shift)) : 0);
+        }
+        trim(q);
+        trim(r);
+    }
+};
+
+class Rational {
+public:
+    Rational() = default;
+    template <typename I, typename = typename std::enable_if<std::is_integral<I>::value>::type>
+    Rational(I value) {
+        int64_t v = static_cast<int64_t>(value);
+        if (v == INT64_MIN) {
+            setBig(BigInt(v), BigInt(1));
+        } else {
+            num = v;
+        }
+    }
+    // The simplest fraction that rounds to value (see fromFloat)
+    explicit Rational(double value) { *this = fromFloat(static_cast<float>(value)); }
+
+    // numerator / denominator, reduced. The denominator must be nonzero.
+    static Rational fraction(const BigInt& numerator, const BigInt& denominator) {
+        Rational result;
+        result.normalize(numerator, denominator);
+        return result;
+    }
+
+    // Values typed as fractions are stored as the nearest float, so recover
+    // the fraction: the first continued-fraction convergent that rounds back
+    // to the same float, which turns 0.33333334f back into 1/3. Values with no
+    // such convergent small enough for 64 bits are taken exactly.
+    static Rational fromFloat(float value) {
+        if (!std::isfinite(value) || value == 0.0f) {
+            return Rational();
+        }
+        double x = std::fabs(static_cast<double>(value));
+        int64_t p0 = 0, q0 = 1, p1 = 1, q1 = 0;
+        for (int i = 0; i < 64; ++i) {
+            double a = std::floor(x);
+            if (a >= 9.0e18) {
+                break;
+            }
+            int64_t p2, q2;
+            if (!checkedMul(static_cast<int64_t>(a), p1, p2) || !checkedAdd(p2, p0, p2) ||
+                !checkedMul(static_cast<int64_t>(a), q1, q2) || !checkedAdd(q2, q0, q2)) {
+                break;
+            }
+            p0 = p1;
+            q0 = q1;
+            p1 = p2;
+            q1 = q2;
+            if (static_cast<float>(static_cast<double>(p1) / static_cast<double>(q1)) == std::fabs(value)) {
+                return fraction(BigInt(value < 0 ? -p1 : p1), BigInt(q1));
+            }
+            if (x == a) {
+                break;
+            }
+            x = 1.0 / (x - a);
+        }
+        int exponent;
+        double mantissa = std::frexp(static_cast<double>(value), &exponent);
+        BigInt scaled(static_cast<int64_t>(std::ldexp(mantissa, 24)));
+        exponent -= 24;
+        if (exponent >= 0) {
+            return fraction(scaled * BigInt::powerOfTwo(static_cast<size_t>(exponent)), BigInt(1));
+        }
+        return fraction(scaled, BigInt::powerOfTwo(static_cast<size_t>(-exponent)));
+    }
+
+    BigInt numerator() const { return big ? big->first : BigInt(num); }
+    BigInt denominator() const { return big ? big->second : BigInt(den); }
+    bool isInteger() const { return big ? big->second == BigInt(1) : den == 1; }
+    bool isSmall() const { return !big; }
+
+    explicit operator double() const {
+        if (!big) {
+            return static_cast<double>(num) / static_cast<double>(den);
+        }
+        long numExponent, denExponent;
+        double n = big->first.toDouble(numExponent);
+        double d = big->second.toDouble(denExponent);
+        return std::ldexp(n / d, static_cast<int>(numExponent - denExponent));
+    }
+    explicit operator float() const { return static_cast<float>(static_cast<double>(*this)); }
+
+    Rational operator-() const {
+        Rational result = *this;
+        if (big) {
+            result.big = std::make_shared<const BigPair>(-big->first, big->second);
+        } else {
+            result.num = -num;
+        }
+        return result;
+    }
+
+    friend Rational operator+(const Rational& a, const Rational& b) {
+        if (!a.big && !b.big) {
+            // a/b + c/d with g = gcd(b, d): (a*(d/g) + c*(b/g)) / (b/g*d), and
+            // only g can still divide the new numerator
+            int64_t g = static_cast<int64_t>(gcd64(a.den, b.den));
+            int64_t left, right, n, d;
+            if (checkedMul(a.num, b.den / g, left) && checkedMul(b.num, a.den / g, right) &&
+                checkedAdd(left, right, n) && n != INT64_MIN) {
+                int64_t g2 = static_cast<int64_t>(gcd64(n < 0 ? -n : n, g));
+                if (checkedMul(a.den / g, b.den / g2, d)) {
+                    return small(n / g2, d);
+                }
+            }
+        }
+        return fraction(a.numerator() * b.denominator() + b.numerator() * a.denominator(),
+                        a.denominator() * b.denominator());
+    }
+
+    friend Rational operator-(const Rational& a, const Rational& b) { return a + -b; }
+
+    friend Rational operator*(const Rational& a, const Rational& b) {
+        if (!a.big && !b.big) {
+            // Cancel across before multiplying so the products stay small
+            int64_t g1 = static_cast<int64_t>(gcd64(a.num < 0 ? -a.num : a.num, b.den));
+            int64_t g2 = static_cast<int64_t>(gcd64(b.num < 0 ? -b.num : b.num, a.den));
+            int64_t n, d;
+            if (checkedMul(a.num / g1, b.num / g2, n) && n != INT64_MIN && checkedMul(a.den / g2, b.den / g1, d)) {
+                return small(n, d);
+            }
+        }
+        return fraction(a.numerator() * b.numerator(), a.denominator() * b.denominator());
+    }
+
+    // Division by zero yields zero; callers check pivots first
+    friend Rational operator/(const Rational& a, const Rational& b) {
+        if (b.isZero()) {
+            return Rational();
+        }
+        return a * b.reciprocal();
+    }
+
+    // (pivot * a - factor * b) / previous for integers when the division is
+    // known to be exact, as in a fraction-free elimination step. Skips the
+    // GCDs and reciprocals the general operators would spend on it.
+    static Rational exactStep(const Rational& pivot, const Rational& a, const Rational& factor, const Rational& b,
+                              const Rational& previous) {
+        if (!pivot.big && !a.big && !factor.big && !b.big && !previous.big) {
+            int64_t left, right, difference;
+            if (checkedMul(pivot.num, a.num, left) && checkedMul(factor.num, b.num, right) &&
+                checkedSub(left, right, difference) && difference != INT64_MIN) {
+                return small(difference / previous.num, 1);
+            }
+        }
+        Rational result;
+        BigInt n = (pivot.numerator() * a.numerator() - factor.numerator() * b.numerator()) / previous.numerator();
+        if (n.fitsInt64()) {
+            result.num = n.toInt64();
+        } else {
+            result.setBig(std::move(n), BigInt(1));
+        }
+        return result;
+    }
+
+    Rational& operator+=(const Rational& other) { return *this = *this + other; }
+    Rational& operator-=(const Rational& other) { return *this = *this - other; }
+    Rational& operator*=(const Rational& other) { return *this = *this * other; }
+    Rational& operator/=(const Rational& other) { return *this = *this / other; }
+
+    bool isZero() const { return !big && num == 0; }
+    bool isNegative() const { return big ? big->first.isNegative() : num < 0; }
+
+    friend bool operator==(const Rational& a, const Rational& b) {
+        if (!a.big && !b.big) {
+            return a.num == b.num && a.den == b.den;
+        }
+        return a.numerator() == b.numerator() && a.denominator() == b.denominator();
+    }
+    friend bool operator!=(const Rational& a, const Rational& b) { return !(a == b); }
+    friend bool operator<(const Rational& a, const Rational& b) { return (a - b).isNegative(); }
+    friend bool operator>(const Rational& a, const Rational& b) { return b < a; }
+
+    friend std::ostream& operator<<(std::ostream& out, const Rational& value) {
+        if (value.isInteger()) {
+            return out << (value.big ? value.big->first.toString() : std::to_string(value.num));
+        }
+        if (value.big) {
+            return out << value.big->first.toString() << "/" << value.big->second.toString();
+        }
+        return out << value.num << "/" << value.den;
+    }
+
+private:
+    using BigPair = std::pair<BigInt, BigInt>;
+
+    int64_t num = 0;
+    int64_t den = 1;
+    std::shared_ptr<const BigPair> big; // Set only when the value does not fit inline
+
+    // n/d already reduced, d > 0
+    static Rational small(int64_t n, int64_t d) {
+        Rational result;
+        result.num = n;
+        result.den = d;
+        return result;
+    }
+
+    Rational reciprocal() const {
+        if (!big) {
+            return num < 0 ? small(-den, -num) : small(den, num);
+        }
+        return fraction(big->second, big->first);
+    }
+
+    void setBig(BigInt n, BigInt d) {
+        num = 0;
+        den = 1;
+        big = std::make_shared<const BigPair>(std::move(n), std::move(d));
+    }
+
+    void normalize(BigInt n, BigInt d) {
+        if (d.isNegative()) {
+            n = -n;
+            d = -d;
+        }
+        BigInt g = BigInt::gcd(n, d);
+        if (!g.isZero() && g != BigInt(1)) {
+            n = n / g;
+            d = d / g;
+        }
+        if (n.isZero()) {
+            *this = Rational();
+        } else if (n.fitsInt64() && d.fitsInt64()) {
+            *this = small(n.toInt64(), d.toInt64());
+        } else {
+            setBig(std::move(n), std::move(d));
+        }
+    }
+};
+
+// Exact reduction of an augmented matrix to RREF.
+//
+// Each row is scaled to integers, then reduced fraction-free (Bareiss): every
+// update is (pivot * a - a[col] * pivotRow) / previousPivot, which divides
+// exactly, so entries stay integers no larger than minors of the input and
+// need no GCDs until the pivot rows are normalized at the end. Row updates
+// within a step are independent and run in parallel.
+SolutionKind reduceToRrefExact(MatrixView<Rational> m) {
+    const size_t rows = m.rows;
+    const size_t columns = m.columns;
+    if (columns == 0) {
+        return SolutionKind::Unique;
+    }
+    const size_t unknowns = columns - 1;
+
+    parallelRange(rows, columns, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            BigInt scale(1);
+            for (size_t j = 0; j < columns; ++j) {
+                if (!m(i, j).isInteger()) {
+                    BigInt d = m(i, j).denominator();
+                    scale = scale / BigInt::gcd(scale, d) * d;
+                }
+            }
+            if (scale != BigInt(1)) {
+                scaleRow(Rational::fraction(scale, BigInt(1)), m.row(i));
+            }
+        }
+    });
+
+    std::vector<size_t> pivotCols;
+    Rational previous(1);
+    size_t r = 0;
+    for (size_t col = 0; col < unknowns && r < rows; ++col) {
+        size_t pivotRow = r;
+        while (pivotRow < rows && m(pivotRow, col).isZero()) {
+            ++pivotRow;
+        }
+        if (pivotRow == rows) {
+            continue;
+        }
+        if (pivotRow != r) {
+            swapRows(m.row(pivotRow), m.row(r));
+        }
+        const Rational pivot = m(r, col);
+        parallelRange(rows, columns * 8, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                if (i == r) {
+                    continue;
+                }
+                const Rational factor = m(i, col);
+                for (size_t j = 0; j < columns; ++j) {
+                    if (j == col) {
+                        m(i, j) = Rational();
+                    } else if (!m(i, j).isZero() || !m(r, j).isZero()) {
+                        m(i, j) = Rational::exactStep(pivot, m(i, j), factor, m(r, j), previous);
+                    }
+                }
+            }
+        });
+        previous = pivot;
+        pivotCols.push_back(col);
+        ++r;
+    }
+    const size_t rank = r;
+
+    parallelRange(rank, columns * 8, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            scaleRow(Rational(1) / m(i, pivotCols[i]), m.row(i));
+        }
+    });
+
+    for (size_t i = rank; i < rows; ++i) {
+        if (!m(i, unknowns).isZero()) {
+            return SolutionKind::Inconsistent;
+        }
+    }
+    return rank < unknowns ? SolutionKind::Infinite : SolutionKind::Unique;
+}
+
+// Binary matrix files (.mtxb)
+//
+// A 64-byte header followed by the rows exactly as Matrix stores them, padded
+// to the leading dimension, starting at a 64-byte aligned offset. Loading maps
+// the data straight into the matrix instead of parsing or copying it. Fields
+// are in host byte order; the magic doubles as an endianness check.
+struct MatrixFileHeader {
+    char magic[4];          // "MTXB"
+    uint32_t version;       // kMatrixFileVersion
+    uint32_t dtype;         // kMatrixFileFloat32
+    uint32_t alignment;     // Alignment of dataOffset in bytes
+    uint64_t rows;
+    uint64_t columns;
+    uint64_t ld;            // Floats between the starts of consecutive rows
+    uint64_t dataOffset;    // Byte offset of row 0
+    uint64_t dataChecksum;  // checksumBytes over rows * ld floats
+    uint64_t headerChecksum; // checksumBytes over every field above
+};
+static_assert(sizeof(MatrixFileHeader) == 64, "MatrixFileHeader must stay 64 bytes");
+
+const uint32_t kMatrixFileVersion = 1;
+const uint32_t kMatrixFileFloat32 = 1;
+
+// FNV-1a over 64-bit words, so checking a multi-GB file stays memory-bound
+uint64_t checksumBytes(const void* data, size_t length) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    uint64_t hash = 1469598103934665603ull;
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, bytes + i, 8);
+        hash = (hash ^ word) * 1099511628211ull;
+    }
+    for (; i < length; ++i) {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+bool Matrix::save(const std::string& path) const {
+    stats::Scope scope(stats::Op::Save, 0, rows * paddedWidth(columns) * sizeof(float));
+    MatrixFileHeader header = {};
+    std::memcpy(header.magic, "MTXB", 4);
+    header.version = kMatrixFileVersion;
+    header.dtype = kMatrixFileFloat32;
+    header.alignment = 64;
+    header.rows = rows;
+    header.columns = columns;
+    header.ld = paddedWidth(columns);
+    header.dataOffset = sizeof(MatrixFileHeader);
+
+    // Files always use the standard row padding, which load insists on
+    std::vector<float> repadded;
+    const float* rowData = data.data();
+    if (ld != header.ld && rows > 0) {
+        repadded.assign(rows * header.ld, 0.0f);
+        for (size_t r = 0; r < rows; ++r) {
+            std::copy(rowPtr(r), rowPtr(r) + columns, repadded.data() + r * header.ld);
+        }
+        rowData = repadded.data();
+    }
+    const size_t dataBytes = rows * header.ld * sizeof(float);
+    header.dataChecksum = checksumBytes(rowData, dataBytes);
+    header.headerChecksum = checksumBytes(&header, offsetof(MatrixFileHeader, headerChecksum));
+
+    bool written = replaceFile(path, [&](std::ofstream& file) {
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(rowData), static_cast<std::streamsize>(dataBytes));
+        return bool(file);
+    });
+    if (!written) {
+        std::cerr << "Error: Could not write matrix " << name << " to " << path << ".\n";
+        return false;
+    }
+    return true;
+}
+
+Matrix Matrix::load(const std::string& path, const std::string& name, bool verify) {
+    stats::Scope scope(stats::Op::Load);
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) {
+        std::cerr << "Error: Could not open " << path << ".\n";
+        return Matrix();
+    }
+    uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+    MatrixFileHeader header;
+    file.seekg(0);
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || std::memcmp(header.magic, "MTXB", 4) != 0) {
+        std::cerr << "Error: " << path << " is not a matrix file.\n";
+        return Matrix();
+    }
+    if (header.headerChecksum != checksumBytes(&header, offsetof(MatrixFileHeader, headerChecksum))) {
+        std::cerr << "Error: " << path << " has a corrupt header.\n";
+        return Matrix();
+    }
+    if (header.version != kMatrixFileVersion || header.dtype != kMatrixFileFloat32) {
+        std::cerr << "Error: " << path << " uses an unsupported version or element type.\n";
+        return Matrix();
+    }
+    // The data is mapped in place, so it must start on a cache line and use
+    // the row padding Matrix gives its own rows
+    if (header.alignment != 64 || header.dataOffset % 64 != 0 || header.ld != paddedWidth(header.columns)) {
+        std::cerr << "Error: " << path << " has misaligned data or rows not padded to "
+                  << paddedWidth(header.columns) << " elements.\n";
+        return Matrix();
+    }
+    if (header.dataOffset > fileSize ||
+        (header.ld > 0 && header.rows > (fileSize - header.dataOffset) / sizeof(float) / header.ld)) {
+        std::cerr << "Error: " << path << " is truncated or has inconsistent dimensions.\n";
+        return Matrix();
+    }
+
+    Matrix loaded(name, 0, 0);
+    loaded.rows = header.rows;
+    loaded.columns = header.columns;
+    loaded.ld = header.ld;
+    std::string error;
+    loaded.data = MatrixBuffer::mapFile(path, header.dataOffset, header.rows * header.ld, error);
+    if (!error.empty()) {
+        std::cerr << "Error: Could not map " << path << ": " << error << ".\n";
+        return Matrix();
+    }
+    if (verify && checksumBytes(loaded.data.data(), header.rows * header.ld * sizeof(float)) != header.dataChecksum) {
+        std::cerr << "Error: " << path << " failed its checksum.\n";
+        return Matrix();
+    }
+    // Only a verified load actually reads the data
+    scope.setWork(0, verify ? loaded.memoryBytes() : 0);
+    return loaded;
+}
+
+// Out-of-core tiled matrices (.mtxt)
+//
+// A TiledMatrix lives in a file rather than in memory: a 64-byte header, then
+// a grid of tileSize x tileSize tiles in row-major tile order, each tile
+// contiguous and row-major. Edge tiles are padded with zeros to the full size
+// so every tile sits at a fixed offset. add, transpose, multiply and solve
+// read their operands a tile at a time and write their result as another
+// tiled file, so they work on matrices far larger than RAM.
+//
+// Reads go through a TileReader, whose I/O thread works through the
+// operation's list of tiles ahead of the computation into a small ring of
+// buffers; writes go through a TileWriter, which drains a similar ring behind
+// it. Disk and CPU stay busy at the same time, and the rings, panels and
+// accumulators an operation holds are sized to fit the memory budget:
+// setMemoryBudget() (the --tile-memory flag), then the MATRIX_TILE_MEMORY
+// environment variable, both in MiB, then 1 GiB.
+struct TiledFileHeader {
+    char magic[4];          // "MTXT"
+    uint32_t version;       // kTiledFileVersion
+    uint32_t dtype;         // kMatrixFileFloat32
+    uint32_t tileSize;      // Rows and columns per tile
+    uint64_t rows;
+    uint64_t columns;
+    uint64_t dataOffset;    // Byte offset of tile (0, 0)
+    uint64_t reserved[2];
+    uint64_t headerChecksum; // checksumBytes over every field above
+};
+static_assert(sizeof(TiledFileHeader) == 64, "TiledFileHeader must stay 64 bytes");
+
+const uint32_t kTiledFileVersion = 1;
+const size_t kDefaultTileSize = 1024;
+const size_t kTileReadAhead = 4;   // Tiles a TileReader may read before they are used
+const size_t kTileWriteBehind = 2; // Tiles a TileWriter may hold before they are written
+
+// One open file read and written at byte offsets, safely from several threads
+class TileFile {
+public:
+    TileFile(const TileFile&) = delete;
+    TileFile& operator=(const TileFile&) = delete;
+    ~TileFile();
+
+    // Open path for reading and writing, creating or truncating it if asked.
+    // Returns null and sets error on failure.
+    static std::unique_ptr<TileFile> open(const std::string& path, bool create, std::string& error);
+
+    bool read(uint64_t offset, void* out, size_t length, std::string& error);
+    bool write(uint64_t offset, const void* data, size_t length, std::string& error);
+    bool resize(uint64_t length, std::string& error); // New space reads as zeros
+    // True if path names this same file, under any name
+    bool isAt(const std::string& path) const;
+
+private:
+    TileFile() = default;
+#if MATRIX_HAVE_MMAP
+    int fd = -1;
+#else
+    std::fstream stream;
+    std::mutex mutex; // fstream has one position shared by every thread
+#endif
+};
+
+#if MATRIX_HAVE_MMAP
+TileFile::~TileFile() {
+    if (fd >= 0) {
+        ::close(fd);
+    }
+}
+
+std::unique_ptr<TileFile> TileFile::open(const std::string& path, bool create, std::string& error) {
+    int fd = ::open(path.c_str(), create ? O_RDWR | O_CREAT | O_TRUNC : O_RDWR, 0644);
+    if (fd < 0) {
+        error = std::strerror(errno);
+        return nullptr;
+    }
+    std::unique_ptr<TileFile> file(new TileFile());
+    file->fd = fd;
+    return file;
+}
+
+bool TileFile::read(uint64_t offset, void* out, size_t length, std::string& error) {
+    char* p = static_cast<char*>(out);
+    while (length > 0) {
+        ssize_t n = ::pread(fd, p, length, static_cast<off_t>(offset));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            error = n < 0 ? std::strerror(errno) : "unexpected end of file";
+            return false;
+        }
+        p += n;
+        offset += static_cast<uint64_t>(n);
+        length -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool TileFile::write(uint64_t offset, const void* data, size_t length, std::string& error) {
+    const char* p = static_cast<const char*>(data);
+    while (length > 0) {
+        ssize_t n = ::pwrite(fd, p, length, static_cast<off_t>(offset));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            error = std::strerror(errno);
+            return false;
+        }
+        p += n;
+        offset += static_cast<uint64_t>(n);
+        length -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Leaves a hole where the filesystem supports it, so creating a 100 GB
+// result costs no I/O until its tiles are written
+bool TileFile::resize(uint64_t length, std::string& error) {
+    if (::ftruncate(fd, static_cast<off_t>(length)) != 0) {
+        error = std::strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+bool TileFile::isAt(const std::string& path) const {
+    struct stat mine, theirs;
+    return ::fstat(fd, &mine) == 0 && ::stat(path.c_str(), &theirs) == 0 && mine.st_dev == theirs.st_dev &&
+           mine.st_ino == theirs.st_ino;
+}
+#else
+TileFile::~TileFile() = default;
+
+std::unique_ptr<TileFile> TileFile::open(const std::string& path, bool create, std::string& error) {
+    std::unique_ptr<TileFile> file(new TileFile());
+    std::ios::openmode mode = std::ios::binary | std::ios::in | std::ios::out;
+    file->stream.open(path, create ? mode | std::ios::trunc : mode);
+    if (!file->stream) {
+        error = "could not open the file";
+        return nullptr;
+    }
+    return file;
+}
+
+bool TileFile::read(uint64_t offset, void* out, size_t length, std::string& error) {
+    std::lock_guard<std::mutex> lock(mutex);
+    stream.seekg(static_cast<std::streamoff>(offset));
+    if (!stream.read(static_cast<char*>(out), static_cast<std::streamsize>(length))) {
+        stream.clear();
+        error = "short read";
+        return false;
+    }
+    return true;
+}
+
+bool TileFile::write(uint64_t offset, const void* data, size_t length, std::string& error) {
+    std::lock_guard<std::mutex> lock(mutex);
+    stream.seekp(static_cast<std::streamoff>(offset));
+    if (!stream.write(static_cast<const char*>(data), static_cast<std::streamsize>(length))) {
+        stream.clear();
+        error = "write failed";
+        return false;
+    }
+    return true;
+}
+
+bool TileFile::resize(uint64_t length, std::string& error) {
+    if (length == 0) {
+        return true;
+    }
+    const char zero = 0;
+    return write(length - 1, &zero, 1, error);
+}
+
+// No file identities to compare; TiledMatrix still compares the paths
+bool TileFile::isAt(const std::string&) const {
+    return false;
+}
+#endif
+
+class TiledMatrix {
+public:
+    TiledMatrix() = default;
+
+    // Create path holding a rows x columns zero matrix, or open an existing
+    // tiled file. Errors are printed and give an empty TiledMatrix.
+    static TiledMatrix create(const std::string& path, size_t rows, size_t columns, size_t tileSize = kDefaultTileSize);
+    static TiledMatrix open(const std::string& path);
+
+    // Write an in-memory matrix out as tiles, or read a tiled one that fits
+    // in memory back in
+    static TiledMatrix fromMatrix(ConstFloatView m, const std::string& path, size_t tileSize = kDefaultTileSize);
+    Matrix toMatrix(const std::string& name) const;
+
+    bool isEmpty() const { return !file; }
+    const std::string& path() const { return filePath; }
+    // True if writing path would overwrite this matrix's file
+    bool isStoredIn(const std::string& path) const { return file && (path == filePath || file->isAt(path)); }
+    size_t rowCount() const { return rows; }
+    size_t columnCount() const { return columns; }
+    size_t tileSize() const { return tile; }
+    size_t tileRows() const { return (rows + tile - 1) / tile; }
+    size_t tileColumns() const { return (columns + tile - 1) / tile; }
+    // Rows of tile row i and columns of tile column j; edge tiles are smaller
+    size_t tileHeight(size_t i) const { return std::min(tile, rows - i * tile); }
+    size_t tileWidth(size_t j) const { return std::min(tile, columns - j * tile); }
+
+    // Whole tiles, padding included. Errors are printed.
+    bool readTile(size_t i, size_t j, float* out) const;
+    bool writeTile(size_t i, size_t j, const float* tileData) const;
+
+    // Each writes its result to path, replacing any file there, and returns
+    // it. Operands must share a tile size. Errors are printed and give an
+    // empty TiledMatrix.
+    TiledMatrix add(const TiledMatrix& other, const std::string& path) const;
+    TiledMatrix transpose(const std::string& path) const;
+    TiledMatrix multiply(const TiledMatrix& other, const std::string& path) const;
+    // Solve A X = B for square A by blocked LU with partial pivoting. The
+    // factors go to a scratch file, path + ".lu", removed afterwards.
+    TiledMatrix solve(const TiledMatrix& rhs, const std::string& path) const;
+
+    static void setMemoryBudget(size_t mebibytes) { requestedBudget() = mebibytes; }
+    static size_t memoryBudget(); // In bytes
+
+private:
+    std::shared_ptr<TileFile> file;
+    std::string filePath;
+    size_t rows = 0;
+    size_t columns = 0;
+    size_t tile = 0;
+
+    uint64_t fileBytes() const { return uint64_t(tileRows()) * tileColumns() * tile * tile * sizeof(float); }
+    uint64_t tileOffset(size_t i, size_t j) const {
+        return sizeof(TiledFileHeader) + (uint64_t(i) * tileColumns() + j) * tile * tile * sizeof(float);
+    }
+
+    static size_t& requestedBudget() {
+        static size_t mebibytes = 0;
+        return mebibytes;
+    }
+    // Tiles of this matrix's size the budget holds, after the reader's and
+    // writer's rings. Prints an error and returns 0 when that is below needed.
+    size_t budgetTiles(size_t needed) const;
+    // Drop a half-written result
+    static TiledMatrix discard(const TiledMatrix& result);
+    // Results are written from the first tile on, so one written over an
+    // operand would destroy it before it is read. Prints an error if so.
+    static bool overwritesOperand(const std::string& outPath, std::initializer_list<const TiledMatrix*> operands);
+};
+
+size_t TiledMatrix::memoryBudget() {
+    size_t mebibytes = requestedBudget();
+    if (mebibytes == 0) {
+        if (const char* env = std::getenv("MATRIX_TILE_MEMORY")) {
+            long value = std::strtol(env, nullptr, 10);
+            mebibytes = value > 0 ? static_cast<size_t>(value) : 0;
+        }
+    }
+    return (mebibytes > 0 ? mebibytes : 1024) << 20;
+}
+
+size_t TiledMatrix::budgetTiles(size_t needed) const {
+    const size_t tileBytes = tile * tile * sizeof(float);
+    const size_t rings = 2 * kTileReadAhead + kTileWriteBehind;
+    size_t total = memoryBudget() / tileBytes;
+    size_t available = total > rings ? total - rings : 0;
+    if (available < needed) {
+        std::cerr << "Error: A memory budget of " << (memoryBudget() >> 20) << " MiB holds too few " << tile << "x"
+                  << tile << " tiles for this operation; it needs " << ((needed + rings) * tileBytes + (1 << 20) - 1) / (1 << 20)
+                  << " MiB, or use smaller tiles.\n";
+        return 0;
+    }
+    return available;
+}
+
+TiledMatrix TiledMatrix::discard(const TiledMatrix& result) {
+    std::remove(result.path().c_str());
+    return TiledMatrix();
+}
+
+bool TiledMatrix::overwritesOperand(const std::string& outPath, std::initializer_list<const TiledMatrix*> operands) {
+    for (const TiledMatrix* operand : operands) {
+        if (operand->isStoredIn(outPath)) {
+            std::cerr << "Error: " << outPath << " holds an operand; write the result to another file.\n";
+            return true;
+        }
+    }
+    return false;
+}
+
+TiledMatrix TiledMatrix::create(const std::string& path, size_t rws, size_t clmns, size_t tileSize) {
+    if (tileSize == 0) {
+        std::cerr << "Error: Tile size must be positive.\n";
+        return TiledMatrix();
+    }
+    std::string error;
+    std::unique_ptr<TileFile> opened = TileFile::open(path, true, error);
+    if (!opened) {
+        std::cerr << "Error: Could not create " << path << ": " << error << ".\n";
+        return TiledMatrix();
+    }
+    TiledMatrix m;
+    m.file = std::move(opened);
+    m.filePath = path;
+    m.rows = rws;
+    m.columns = clmns;
+    m.tile = tileSize;
+
+    TiledFileHeader header = {};
+    std::memcpy(header.magic, "MTXT", 4);
+    header.version = kTiledFileVersion;
+    header.dtype = kMatrixFileFloat32;
+    header.tileSize = static_cast<uint32_t>(tileSize);
+    header.rows = rws;
+    header.columns = clmns;
+    header.dataOffset = sizeof(TiledFileHeader);
+    header.headerChecksum = checksumBytes(&header, offsetof(TiledFileHeader, headerChecksum));
+    if (!m.file->write(0, &header, sizeof(header), error) || !m.file->resize(sizeof(header) + m.fileBytes(), error)) {
+        std::cerr << "Error: Could not write " << path << ": " << error << ".\n";
+        return discard(m);
+    }
+    return m;
+}
+
+TiledMatrix TiledMatrix::open(const std::string& path) {
+    std::string error;
+    std::unique_ptr<TileFile> opened = TileFile::open(path, false, error);
+    if (!opened) {
+        std::cerr << "Error: Could not open " << path << ": " << error << ".\n";
+        return TiledMatrix();
+    }
+    TiledFileHeader header;
+    if (!opened->read(0, &header, sizeof(header), error) || std::memcmp(header.magic, "MTXT", 4) != 0) {
+        std::cerr << "Error: " << path << " is not a tiled matrix file.\n";
+        return TiledMatrix();
+    }
+    if (header.headerChecksum != checksumBytes(&header, offsetof(TiledFileHeader, headerChecksum))) {
+        std::cerr << "Error: " << path << " has a corrupt header.\n";
+        return TiledMatrix();
+    }
+    if (header.version != kTiledFileVersion || header.dtype != kMatrixFileFloat32 || header.tileSize == 0 ||
+        header.dataOffset != sizeof(TiledFileHeader)) {
+        std::cerr << "Error: " << path << " uses an unsupported version, element type or layout.\n";
+        return TiledMatrix();
+    }
+    TiledMatrix m;
+    m.file = std::move(opened);
+    m.filePath = path;
+    m.rows = header.rows;
+    m.columns = header.columns;
+    m.tile = header.tileSize;
+    return m;
+}
+
+bool TiledMatrix::readTile(size_t i, size_t j, float* out) const {
+    std::string error;
+    if (!file->read(tileOffset(i, j), out, tile * tile * sizeof(float), error)) {
+        std::cerr << "Error: Could not read tile (" << i + 1 << ", " << j + 1 << ") of " << filePath << ": " << error << ".\n";
+        return false;
+    }
+    return true;
+}
+
+bool TiledMatrix::writeTile(size_t i, size_t j, const float* tileData) const {
+    std::string error;
+    if (!file->write(tileOffset(i, j), tileData, tile * tile * sizeof(float), error)) {
+        std::cerr << "Error: Could not write tile (" << i + 1 << ", " << j + 1 << ") of " << filePath << ": " << error << ".\n";
+        return false;
+    }
+    return true;
+}
+
+// Reads a fixed list of tiles, in order, on its own thread, never more than
+// slots ahead of what has been released. acquire() hands the tiles out in
+// list order; release() frees the oldest one still held.
+class TileReader {
+public:
+    struct Request {
+        const TiledMatrix* matrix;
+        size_t i, j;
+    };
+
+    TileReader(std::vector<Request> list, size_t tileFloats, size_t slots = kTileReadAhead)
+        : requests(std::move(list)), tileFloats(tileFloats), slots(slots), buffers(tileFloats * slots),
+          worker([this] { readAll(); }) {}
+
+    ~TileReader() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        changed.notify_all();
+        worker.join();
+    }
+
+    // The next tile in the list, waiting for it if need be; null if it could
+    // not be read (the error has been printed)
+    const float* acquire() {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this] { return readCount > acquired || failed; });
+        if (readCount <= acquired) {
+            return nullptr;
+        }
+        return buffers.data() + (acquired++ % slots) * tileFloats;
+    }
+
+    void release() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++released;
+        }
+        changed.notify_all();
+    }
+
+private:
+    std::vector<Request> requests;
+    size_t tileFloats;
+    size_t slots;
+    MatrixBuffer buffers;
+    std::mutex mutex;
+    std::condition_variable changed;
+    size_t readCount = 0;
+    size_t acquired = 0;
+    size_t released = 0;
+    bool failed = false;
+    bool stopping = false;
+    std::thread worker; // Last, so everything above exists before it starts
+
+    void readAll() {
+        for (size_t t = 0; t < requests.size(); ++t) {
+            float* slot;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&] { return stopping || t - released < slots; });
+                if (stopping) {
+                    return;
+                }
+                slot = buffers.data() + (t % slots) * tileFloats;
+            }
+            const Request& r = requests[t];
+            bool ok = r.matrix->readTile(r.i, r.j, slot);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (ok) {
+                    readCount = t + 1;
+                } else {
+                    failed = true;
+                }
+            }
+            changed.notify_all();
+            if (!ok) {
+                return;
+            }
+        }
+    }
+};
+
+// Writes tiles on its own thread behind the computation. submit() copies the
+// tile into a free slot, waiting for one if every slot is still queued.
+class TileWriter {
+public:
+    explicit TileWriter(size_t tileFloats, size_t slots = kTileWriteBehind)
+        : tileFloats(tileFloats), slots(slots), buffers(tileFloats * slots), targets(slots),
+          worker([this] { writeAll(); }) {}
+
+    ~TileWriter() {
+        finish();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        changed.notify_all();
+        worker.join();
+    }
+
+    void submit(const TiledMatrix& matrix, size_t i, size_t j, const float* tileData) {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this] { return submitted - written < slots || failed; });
+        if (failed) {
+            return;
+        }
+        size_t slot = submitted % slots;
+        lock.unlock();
+        std::copy(tileData, tileData + tileFloats, buffers.data() + slot * tileFloats);
+        targets[slot] = {&matrix, i, j};
+        lock.lock();
+        ++submitted;
+        lock.unlock();
+        changed.notify_all();
+    }
+
+    // Wait until every submitted tile is written; false if any write failed
+    bool finish() {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this] { return written == submitted || failed; });
+        return !failed;
+    }
+
+private:
+    size_t tileFloats;
+    size_t slots;
+    MatrixBuffer buffers;
+    std::vector<TileReader::Request> targets;
+    std::mutex mutex;
+    std::condition_variable changed;
+    size_t submitted = 0;
+    size_t written = 0;
+    bool failed = false;
+    bool stopping = false;
+    std::thread worker; // Last, so everything above exists before it starts
+
+    void writeAll() {
+        for (;;) {
+            size_t slot;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [this] { return stopping || written < submitted; });
+                if (written == submitted) {
+                    return;
+                }
+                slot = written % slots;
+            }
+            const TileReader::Request& t = targets[slot];
+            bool ok = t.matrix->writeTile(t.i, t.j, buffers.data() + slot * tileFloats);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (ok) {
+                    ++written;
+                } else {
+                    failed = true;
+                }
+            }
+            changed.notify_all();
+            if (!ok) {
+                return;
+            }
+        }
+    }
+};
+
+TiledMatrix TiledMatrix::fromMatrix(ConstFloatView m, const std::string& path, size_t tileSize) {
+    TiledMatrix result = create(path, m.rows, m.columns, tileSize);
+    if (result.isEmpty()) {
+        return result;
+    }
+    MatrixBuffer staging(tileSize * tileSize);
+    FloatView t{staging.data(), tileSize, tileSize, static_cast<ptrdiff_t>(tileSize), 1};
+    for (size_t i = 0; i < result.tileRows(); ++i) {
+        for (size_t j = 0; j < result.tileColumns(); ++j) {
+            const size_t h = result.tileHeight(i), w = result.tileWidth(j);
+            if (h < tileSize || w < tileSize) {
+                std::fill(staging.data(), staging.data() + tileSize * tileSize, 0.0f);
+            }
+            for (size_t r = 0; r < h; ++r) {
+                for (size_t c = 0; c < w; ++c) {
+                    t(r, c) = m(i * tileSize + r, j * tileSize + c);
+                }
+            }
+            if (!result.writeTile(i, j, staging.data())) {
+                return discard(result);
+            }
+        }
+    }
+    return result;
+}
+
+Matrix TiledMatrix::toMatrix(const std::string& name) const {
+    if (isEmpty()) {
+        return Matrix();
+    }
+    Matrix m(name, rows, columns);
+    FloatView v = m.view();
+    MatrixBuffer staging(tile * tile);
+    for (size_t i = 0; i < tileRows(); ++i) {
+        for (size_t j = 0; j < tileColumns(); ++j) {
+            if (!readTile(i, j, staging.data())) {
+                return Matrix();
+            }
+            const float* t = staging.data();
+            for (size_t r = 0; r < tileHeight(i); ++r) {
+                std::copy(t + r * tile, t + r * tile + tileWidth(j), &v(i * tile + r, j * tile));
+            }
+        }
+    }
+    return m;
+}
+
+TiledMatrix TiledMatrix::add(const TiledMatrix& other, const std::string& outPath) const {
+    if (isEmpty() || other.isEmpty() || rows != other.rows || columns != other.columns || tile != other.tile) {
+        std::cerr << "Error: Tiled matrices must have the same dimensions and tile size to be added.\n";
+        return TiledMatrix();
+    }
+    if (overwritesOperand(outPath, {this, &other}) || budgetTiles(1) == 0) {
+        return TiledMatrix();
+    }
+    stats::Scope scope(stats::Op::TiledAdd, rows * columns, 3 * fileBytes());
+    TiledMatrix result = create(outPath, rows, columns, tile);
+    if (result.isEmpty()) {
+        return result;
+    }
+    const size_t tileFloats = tile * tile;
+    std::vector<TileReader::Request> order;
+    for (size_t i = 0; i < tileRows(); ++i) {
+        for (size_t j = 0; j < tileColumns(); ++j) {
+            order.push_back({this, i, j});
+            order.push_back({&other, i, j});
+        }
+    }
+    // Tiles are used in pairs, so the ring is twice the usual size
+    TileReader reader(std::move(order), tileFloats, 2 * kTileReadAhead);
+    TileWriter writer(tileFloats);
+    MatrixBuffer sum(tileFloats);
+    for (size_t i = 0; i < tileRows(); ++i) {
+        for (size_t j = 0; j < tileColumns(); ++j) {
+            const float* a = reader.acquire();
+            const float* b = a ? reader.acquire() : nullptr;
+            if (!b) {
+                return discard(result);
+            }
+            float* s = sum.data();
+            parallelRange(tileFloats, 1, [&](size_t begin, size_t end) {
+                for (size_t k = begin; k < end; ++k) {
+                    s[k] = a[k] + b[k];
+                }
+            });
+            reader.release();
+            reader.release();
+            writer.submit(result, i, j, s);
+        }
+    }
+    return writer.finish() ? result : discard(result);
+}
+
+TiledMatrix TiledMatrix::transpose(const std::string& outPath) const {
+    if (isEmpty() || overwritesOperand(outPath, {this}) || budgetTiles(1) == 0) {
+        return TiledMatrix();
+    }
+    stats::Scope scope(stats::Op::TiledTranspose, 0, 2 * fileBytes());
+    TiledMatrix result = create(outPath, columns, rows, tile);
+    if (result.isEmpty()) {
+        return result;
+    }
+    const size_t tileFloats = tile * tile;
+    std::vector<TileReader::Request> order;
+    for (size_t i = 0; i < tileRows(); ++i) {
+        for (size_t j = 0; j < tileColumns(); ++j) {
+            order.push_back({this, i, j});
+        }
+    }
+    TileReader reader(std::move(order), tileFloats);
+    TileWriter writer(tileFloats);
+    MatrixBuffer transposed(tileFloats);
+    const ptrdiff_t ld = static_cast<ptrdiff_t>(tile);
+    for (size_t i = 0; i < tileRows(); ++i) {
+        for (size_t j = 0; j < tileColumns(); ++j) {
+            const float* a = reader.acquire();
+            if (!a) {
+                return discard(result);
+            }
+            // The whole tile, so the zero padding lands where the result's padding goes
+            transposeInto<float>(ConstFloatView{a, tile, tile, ld, 1}, FloatView{transposed.data(), tile, tile, ld, 1});
+            reader.release();
+            writer.submit(result, j, i, transposed.data());
+        }
+    }
+    return writer.finish() ? result : discard(result);
+}
+
+// A block of h tile rows of A stays in memory while every tile column of B
+// streams past it, so B is read once per block rather than once per tile
+// row. The block is as tall as the budget allows.
+TiledMatrix TiledMatrix::multiply(const TiledMatrix& other, const std::string& outPath) const {
+    if (isEmpty() || other.isEmpty() || columns != other.rows || tile != other.tile) {
+        std::cerr << "Error: The number of columns in the first tiled matrix must equal the number of rows in the "
+                     "second, and their tile sizes must match.\n";
+        return TiledMatrix();
+    }
+    if (overwritesOperand(outPath, {this, &other})) {
+        return TiledMatrix();
+    }
+    const size_t mt = tileRows(), kt = tileColumns(), nt = other.tileColumns();
+    // Each tile row of the block holds kt tiles of A and one accumulator
+    const size_t available = budgetTiles(kt + 1);
+    if (available == 0) {
+        return TiledMatrix();
+    }
+    const size_t blockRows = std::max<size_t>(1, std::min(mt, available / (kt + 1)));
+    const size_t blocks = (mt + blockRows - 1) / blockRows;
+    stats::Scope scope(stats::Op::TiledMultiply, 2 * rows * columns * other.columns,
+                       fileBytes() + blocks * other.fileBytes() + uint64_t(mt) * nt * tile * tile * sizeof(float));
+    TiledMatrix result = create(outPath, rows, other.columns, tile);
+    if (result.isEmpty()) {
+        return result;
+    }
+
+    const size_t tileFloats = tile * tile;
+    const ptrdiff_t ld = static_cast<ptrdiff_t>(tile);
+    std::vector<TileReader::Request> order;
+    for (size_t i0 = 0; i0 < mt; i0 += blockRows) {
+        const size_t i1 = std::min(mt, i0 + blockRows);
+        for (size_t i = i0; i < i1; ++i) {
+            for (size_t p = 0; p < kt; ++p) {
+                order.push_back({this, i, p});
+            }
+        }
+        for (size_t j = 0; j < nt; ++j) {
+            for (size_t p = 0; p < kt; ++p) {
+                order.push_back({&other, p, j});
+            }
+        }
+    }
+    TileReader reader(std::move(order), tileFloats);
+    TileWriter writer(tileFloats);
+    MatrixBuffer block(blockRows * kt * tileFloats);
+    MatrixBuffer sums(blockRows * tileFloats);
+
+    for (size_t i0 = 0; i0 < mt; i0 += blockRows) {
+        const size_t i1 = std::min(mt, i0 + blockRows);
+        for (size_t i = i0; i < i1; ++i) {
+            for (size_t p = 0; p < kt; ++p) {
+                const float* a = reader.acquire();
+                if (!a) {
+                    return discard(result);
+                }
+                std::copy(a, a + tileFloats, block.data() + ((i - i0) * kt + p) * tileFloats);
+                reader.release();
+            }
+        }
+        for (size_t j = 0; j < nt; ++j) {
+            std::fill(sums.data(), sums.data() + (i1 - i0) * tileFloats, 0.0f);
+            for (size_t p = 0; p < kt; ++p) {
+                const float* b = reader.acquire();
+                if (!b) {
+                    return discard(result);
+                }
+                ConstFloatView bTile{b, other.tileHeight(p), other.tileWidth(j), ld, 1};
+                for (size_t i = i0; i < i1; ++i) {
+                    ConstFloatView aTile{block.data() + ((i - i0) * kt + p) * tileFloats, tileHeight(i), tileWidth(p), ld, 1};
+                    multiplyAddInto(aTile, bTile, FloatView{sums.data() + (i - i0) * tileFloats, tileHeight(i), bTile.columns, ld, 1});
+                }
+                reader.release();
+            }
+            for (size_t i = i0; i < i1; ++i) {
+                writer.submit(result, i, j, sums.data() + (i - i0) * tileFloats);
+            }
+        }
+    }
+    return writer.finish() ? result : discard(result);
+}
+
+// Factor the tall panel s in place with partial pivoting, the way the forward
+// sweep of reduceToRrefBlocked does: kRrefPanel columns unblocked, then one
+// triangular solve and one GEMM for the columns to their right. pivots[c] is
+// the row of s swapped into row c. Returns false on a negligible pivot.
+bool factorTallPanel(FloatView s, float tolerance, size_t* pivots) {
+    const size_t rows = s.rows, width = s.columns;
+    for (size_t j0 = 0; j0 < width; j0 += kRrefPanel) {
+        const size_t j1 = std::min(width, j0 + kRrefPanel);
+        for (size_t col = j0; col < j1; ++col) {
+            size_t pivotRow = col;
+            for (size_t i = col + 1; i < rows; ++i) {
+                if (std::fabs(s(i, col)) > std::fabs(s(pivotRow, col))) {
+                    pivotRow = i;
+                }
+            }
+            if (std::fabs(s(pivotRow, col)) <= tolerance) {
+                return false;
+            }
+            pivots[col] = pivotRow;
+            if (pivotRow != col) {
+                swapRows(s.row(pivotRow), s.row(col));
+            }
+            const float pivot = s(col, col);
+            ConstFloatView pivotTail = s.block(col, col + 1, 1, j1 - col - 1);
+            parallelRange(rows - col - 1, j1 - col, [&](size_t begin, size_t end) {
+                for (size_t i = col + 1 + begin; i < col + 1 + end; ++i) {
+                    float factor = s(i, col) / pivot;
+                    s(i, col) = factor;
+                    if (factor != 0.0f) {
+                        addScaledRow(-factor, pivotTail, s.block(i, col + 1, 1, j1 - col - 1));
+                    }
+                }
+            });
+        }
+        if (j1 == width) {
+            break;
+        }
+
+        // U12 = L11^-1 * A12
+        const size_t panelColumns = j1 - j0;
+        FloatView trailing = s.block(j0, j1, rows - j0, width - j1);
+        parallelRange(trailing.columns, panelColumns * panelColumns, [&](size_t begin, size_t end) {
+            for (size_t i = 1; i < panelColumns; ++i) {
+                for (size_t k = 0; k < i; ++k) {
+                    float factor = s(j0 + i, j0 + k);
+                    if (factor != 0.0f) {
+                        addScaledRow(-factor, trailing.block(k, begin, 1, end - begin), trailing.block(i, begin, 1, end - begin));
+                    }
+                }
+            }
+        });
+
+        // A22 += -L21 * U12
+        const size_t below = rows - j1;
+        std::vector<float, AlignedAllocator<float>> negL21(below * panelColumns);
+        FloatView l21{negL21.data(), below, panelColumns, static_cast<ptrdiff_t>(panelColumns), 1};
+        for (size_t i = 0; i < below; ++i) {
+            for (size_t k = 0; k < panelColumns; ++k) {
+                l21(i, k) = -s(j1 + i, j0 + k);
+            }
+        }
+        multiplyAddInto(l21, trailing.block(0, 0, panelColumns, trailing.columns),
+                        trailing.block(panelColumns, 0, below, trailing.columns));
+    }
+    return true;
+}
+
+// Left-looking blocked LU. The columns of A are taken a panel at a time, as
+// many tile columns as the budget holds at the full height of A. Each panel
+// is read in, brought up to date with the row interchanges and L factors of
+// every earlier panel (streamed back from the factors file), factored in
+// memory and written out; only the factors of earlier panels are ever
+// re-read. The panels of B then get the same forward updates, followed by
+// back substitution with U.
+//
+// L is stored as each panel left it: later interchanges are not applied to
+// earlier panels on disk. Replaying interchanges and updates in panel order
+// gives the same result, and saves rewriting the factors after every panel.
+TiledMatrix TiledMatrix::solve(const TiledMatrix& rhs, const std::string& outPath) const {
+    if (isEmpty() || rhs.isEmpty() || rows != columns || rhs.rows != rows || rhs.tile != tile) {
+        std::cerr << "Error: Tiled solve needs a square matrix and a right-hand side with as many rows, with the same "
+                     "tile size.\n";
+        return TiledMatrix();
+    }
+    if (overwritesOperand(outPath, {this, &rhs}) || overwritesOperand(outPath + ".lu", {this, &rhs})) {
+        return TiledMatrix();
+    }
+    const size_t nt = tileRows();
+    // A panel tile column is nt tiles; add a staging tile and a scratch tile
+    const size_t available = budgetTiles(nt + 2);
+    if (available == 0) {
+        return TiledMatrix();
+    }
+    const size_t panelTiles = (available - 2) / nt;
+    const size_t panelWidth = std::min(std::max(tileColumns(), rhs.tileColumns()), panelTiles) * tile;
+    stats::Scope scope(stats::Op::TiledSolve, 2 * rows * rows * rows / 3 + 2 * rows * rows * rhs.columns,
+                       fileBytes() + 2 * rhs.fileBytes());
+
+    const size_t tileFloats = tile * tile;
+    const ptrdiff_t ld = static_cast<ptrdiff_t>(tile);
+
+    // Pivots this small relative to A count as zero, as in LUFactorization
+    float maxAbs = 0.0f;
+    {
+        std::vector<TileReader::Request> order;
+        for (size_t i = 0; i < nt; ++i) {
+            for (size_t j = 0; j < nt; ++j) {
+                order.push_back({this, i, j});
+            }
+        }
+        TileReader reader(std::move(order), tileFloats);
+        for (size_t t = 0; t < nt * nt; ++t) {
+            const float* a = reader.acquire();
+            if (!a) {
+                return TiledMatrix();
+            }
+            for (size_t k = 0; k < tileFloats; ++k) {
+                maxAbs = std::max(maxAbs, std::fabs(a[k]));
+            }
+            reader.release();
+        }
+    }
+    const float tolerance = maxAbs * static_cast<float>(rows) * std::numeric_limits<float>::epsilon();
+
+    TiledMatrix factors = create(outPath + ".lu", rows, columns, tile);
+    if (factors.isEmpty()) {
+        return factors;
+    }
+    TiledMatrix result = create(outPath, rows, rhs.columns, tile);
+    if (result.isEmpty()) {
+        discard(factors);
+        return result;
+    }
+    auto fail = [&] {
+        discard(factors);
+        return discard(result);
+    };
+
+    Matrix panelStore("Panel", rows, panelWidth);
+    MatrixBuffer staging(tileFloats);
+    MatrixBuffer scratch(tileFloats);
+    std::vector<size_t> pivots(rows); // Row swapped into row c when column c was factored
+    const size_t tilesPerPanel = panelWidth / tile;
+
+    // Read tile columns [j0, j1) of m into the panel
+    auto readPanel = [&](const TiledMatrix& m, size_t j0, size_t j1, FloatView p) {
+        std::vector<TileReader::Request> order;
+        for (size_t i = 0; i < nt; ++i) {
+            for (size_t j = j0; j < j1; ++j) {
+                order.push_back({&m, i, j});
+            }
+        }
+        TileReader reader(std::move(order), tileFloats);
+        for (size_t i = 0; i < nt; ++i) {
+            for (size_t j = j0; j < j1; ++j) {
+                const float* t = reader.acquire();
+                if (!t) {
+                    return false;
+                }
+                for (size_t r = 0; r < m.tileHeight(i); ++r) {
+                    std::copy(t + r * tile, t + r * tile + m.tileWidth(j), &p(i * tile + r, (j - j0) * tile));
+                }
+                reader.release();
+            }
+        }
+        return true;
+    };
+
+    // Write the panel back as tile columns [j0, j1) of m
+    auto writePanel = [&](const TiledMatrix& m, size_t j0, size_t j1, FloatView p) {
+        TileWriter writer(tileFloats);
+        FloatView t{staging.data(), tile, tile, ld, 1};
+        for (size_t i = 0; i < nt; ++i) {
+            for (size_t j = j0; j < j1; ++j) {
+                const size_t h = m.tileHeight(i), w = m.tileWidth(j);
+                if (h < tile || w < tile) {
+                    std::fill(staging.data(), staging.data() + tileFloats, 0.0f);
+                }
+                for (size_t r = 0; r < h; ++r) {
+                    std::copy(&p(i * tile + r, (j - j0) * tile), &p(i * tile + r, (j - j0) * tile) + w, &t(r, 0));
+                }
+                writer.submit(m, i, j, staging.data());
+            }
+        }
+        return writer.finish();
+    };
+
+    // p -= L * p for tile rows i > kk, using the negated L tile in scratch
+    auto subtractProduct = [&](const float* l, size_t i, size_t kk, FloatView p) {
+        const size_t h = tileHeight(i), w = tileWidth(kk);
+        for (size_t r = 0; r < h; ++r) {
+            for (size_t c = 0; c < w; ++c) {
+                scratch.data()[r * tile + c] = -l[r * tile + c];
+            }
+        }
+        multiplyAddInto(ConstFloatView{scratch.data(), h, w, ld, 1}, p.block(kk * tile, 0, w, p.columns),
+                        p.block(i * tile, 0, h, p.columns));
+    };
+
+    // Apply the interchanges and L factors of tile columns [0, done) to p
+    auto forward = [&](size_t done, FloatView p) {
+        std::vector<TileReader::Request> order;
+        for (size_t kk = 0; kk < done; ++kk) {
+            for (size_t i = kk; i < nt; ++i) {
+                order.push_back({&factors, i, kk});
+            }
+        }
+        TileReader reader(std::move(order), tileFloats);
+        for (size_t d0 = 0; d0 < done; d0 += tilesPerPanel) {
+            const size_t d1 = std::min(done, d0 + tilesPerPanel);
+            for (size_t c = d0 * tile; c < std::min(d1 * tile, rows); ++c) {
+                if (pivots[c] != c) {
+                    swapRows(p.row(pivots[c]), p.row(c));
+                }
+            }
+            for (size_t kk = d0; kk < d1; ++kk) {
+                const float* diagonal = reader.acquire();
+                if (!diagonal) {
+                    return false;
+                }
+                const size_t r0 = kk * tile;
+                for (size_t r = 1; r < tileHeight(kk); ++r) {
+                    for (size_t k = 0; k < r; ++k) {
+                        float factor = diagonal[r * tile + k];
+                        if (factor != 0.0f) {
+                            addScaledRow(-factor, p.row(r0 + k), p.row(r0 + r));
+                        }
+                    }
+                }
+                reader.release();
+                for (size_t i = kk + 1; i < nt; ++i) {
+                    const float* l = reader.acquire();
+                    if (!l) {
+                        return false;
+                    }
+                    subtractProduct(l, i, kk, p);
+                    reader.release();
+                }
+            }
+        }
+        return true;
+    };
+
+    // Solve U x = p in place, the last tile row first
+    auto backward = [&](FloatView p) {
+        std::vector<TileReader::Request> order;
+        for (size_t kk = nt; kk-- > 0;) {
+            for (size_t i = 0; i <= kk; ++i) {
+                order.push_back({&factors, i == 0 ? kk : i - 1, kk});
+            }
+        }
+        TileReader reader(std::move(order), tileFloats);
+        for (size_t kk = nt; kk-- > 0;) {
+            const float* diagonal = reader.acquire();
+            if (!diagonal) {
+                return false;
+            }
+            const size_t r0 = kk * tile;
+            for (size_t r = tileHeight(kk); r-- > 0;) {
+                for (size_t k = r + 1; k < tileHeight(kk); ++k) {
+                    float factor = diagonal[r * tile + k];
+                    if (factor != 0.0f) {
+                        addScaledRow(-factor, p.row(r0 + k), p.row(r0 + r));
+                    }
+                }
+                scaleRow(1.0f / diagonal[r * tile + r], p.row(r0 + r));
+            }
+            reader.release();
+            for (size_t i = 0; i < kk; ++i) {
+                const float* u = reader.acquire();
+                if (!u) {
+                    return false;
+                }
+                subtractProduct(u, i, kk, p);
+                reader.release();
+            }
+        }
+        return true;
+    };
+
+    for (size_t j0 = 0; j0 < tileColumns(); j0 += tilesPerPanel) {
+        const size_t j1 = std::min(tileColumns(), j0 + tilesPerPanel);
+        const size_t c0 = j0 * tile, width = std::min(j1 * tile, columns) - c0;
+        FloatView p = panelStore.view().block(0, 0, rows, width);
+        if (!readPanel(*this, j0, j1, p) || !forward(j0, p)) {
+            return fail();
+        }
+        if (!factorTallPanel(p.block(c0, 0, rows - c0, width), tolerance, &pivots[c0])) {
+            std::cerr << "Error: Tiled matrix " << filePath << " is singular.\n";
+            return fail();
+        }
+        for (size_t c = c0; c < c0 + width; ++c) {
+            pivots[c] += c0;
+        }
+        if (!writePanel(factors, j0, j1, p)) {
+            return fail();
+        }
+    }
+
+    for (size_t j0 = 0; j0 < rhs.tileColumns(); j0 += tilesPerPanel) {
+        const size_t j1 = std::min(rhs.tileColumns(), j0 + tilesPerPanel);
+        const size_t width = std::min(j1 * tile, rhs.columns) - j0 * tile;
+        FloatView p = panelStore.view().block(0, 0, rows, width);
+        if (!readPanel(rhs, j0, j1, p) || !forward(nt, p) || !backward(p) || !writePanel(result, j0, j1, p)) {
+            return fail();
+        }
+    }
+    discard(factors);
+    return result;
+}
+
+// Text import
+//
+// CSV, whitespace-separated and Matrix Market (.mtx) files are read with one
+// bulk read and parsed in parallel chunks split at line boundaries. Blank
+// lines and lines starting with '#' or '%' are skipped in delimited files.
+// Errors name the first offending line and never throw.
+namespace textimport {
+
+// Below this many bytes a file is parsed on the calling thread
+const size_t kParallelBytes = 1 << 20;
+
+struct Triplet {
+    size_t row;
+    size_t col;
+    float value;
+};
+
+// First error found in a chunk; line 0 means none
+struct ChunkError {
+    size_t line = 0;
+    std::string message;
+};
+
+bool readFile(const std::string& path, std::string& contents, std::string& error) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) {
+        error = "Could not open " + path + ".";
+        return false;
+    }
+    contents.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    if (!file.read(&contents[0], static_cast<std::streamsize>(contents.size()))) {
+        error = "Could not read " + path + ".";
+        return false;
+    }
+    return true;
+}
+
+// Split [begin, text.size()) into up to parts ranges that start on line starts
+std::vector<size_t> chunkBounds(const std::string& text, size_t begin, size_t parts) {
+    std::vector<size_t> bounds{begin};
+    size_t step = std::max<size_t>(1, (text.size() - begin) / parts);
+    for (size_t i = 1; i < parts; ++i) {
+        size_t pos = std::max(bounds.back(), begin + i * step);
+        pos = text.find('\n', pos);
+        if (pos == std::string::npos) {
+            break;
+        }
+        if (pos + 1 > bounds.back()) {
+            bounds.push_back(pos + 1);
+        }
+    }
+    bounds.push_back(text.size());
+    return bounds;
+}
+
+size_t chunkCount(const std::string& text) {
+    return text.size() < kParallelBytes ? 1 : ThreadPool::instance().size() * 4;
+}
+
+// Call fn(first, last, lineNumber) for each line of [begin, end)
+template <typename F>
+void forEachLine(const std::string& text, size_t begin, size_t end, size_t firstLine, F fn) {
+    const char* p = text.data() + begin;
+    const char* stop = text.data() + end;
+    size_t lineNumber = firstLine;
+    while (p < stop) {
+        const char* eol = static_cast<const char*>(std::memchr(p, '\n', static_cast<size_t>(stop - p)));
+        const char* lineEnd = eol ? eol : stop;
+        if (!fn(p, lineEnd, lineNumber)) {
+            return;
+        }
+        ++lineNumber;
+        p = lineEnd + 1;
+    }
+}
+
+bool isDataLine(const char* first, const char* last) {
+    while (first != last && isFieldSpace(*first)) {
+        ++first;
+    }
+    return first != last && *first != '#' && *first != '%';
+}
+
+// Count lines and data lines per chunk so each chunk knows where its rows start
+void countLines(const std::string& text, const std::vector<size_t>& bounds,
+                std::vector<size_t>& lineStart, std::vector<size_t>& dataStart, size_t firstLine) {
+    size_t chunks = bounds.size() - 1;
+    std::vector<size_t> lines(chunks), data(chunks);
+    ThreadPool::instance().parallelFor(chunks, [&](size_t c) {
+        forEachLine(text, bounds[c], bounds[c + 1], 0, [&](const char* first, const char* last, size_t) {
+            ++lines[c];
+            data[c] += isDataLine(first, last) ? 1 : 0;
+            return true;
+        });
+    });
+    lineStart.assign(chunks + 1, firstLine);
+    dataStart.assign(chunks + 1, 0);
+    for (size_t c = 0; c < chunks; ++c) {
+        lineStart[c + 1] = lineStart[c] + lines[c];
+        dataStart[c + 1] = dataStart[c] + data[c];
+    }
+}
+
+// Return the earliest chunk error, if any
+bool firstError(const std::vector<ChunkError>& errors, std::string& error) {
+    for (const ChunkError& e : errors) {
+        if (e.line != 0) {
+            error = "line " + std::to_string(e.line) + ": " + e.message;
+            return true;
+        }
+    }
+    return false;
+}
+
+Matrix parseDelimited(const std::string& text, const std::string& name, std::string& error) {
+    // The first data line fixes the column count and the delimiter
+    size_t columns = 0;
+    bool csv = false;
+    forEachLine(text, 0, text.size(), 1, [&](const char* first, const char* last, size_t) {
+        if (!isDataLine(first, last)) {
+            return true;
+        }
+        csv = std::find(first, last, ',') != last;
+        std::pair<const char*, const char*> badToken;
+        parseRow(first, last, csv, nullptr, 0, columns, badToken);
+        return false;
+    });
+
+    std::vector<size_t> bounds = chunkBounds(text, 0, chunkCount(text));
+    std::vector<size_t> lineStart, dataStart;
+    countLines(text, bounds, lineStart, dataStart, 1);
+    size_t chunks = bounds.size() - 1;
+
+    Matrix result(name, dataStart[chunks], columns);
+    FloatView target = result.view();
+    std::vector<ChunkError> errors(chunks);
+    ThreadPool::instance().parallelFor(chunks, [&](size_t c) {
+        size_t row = dataStart[c];
+        forEachLine(text, bounds[c], bounds[c + 1], lineStart[c], [&](const char* first, const char* last, size_t line) {
+            if (!isDataLine(first, last)) {
+                return true;
+            }
+            size_t count;
+            std::pair<const char*, const char*> badToken;
+            switch (parseRow(first, last, csv, &target(row, 0), columns, count, badToken)) {
+                case RowParse::Ok:
+                    ++row;
+                    return true;
+                case RowParse::InvalidNumber:
+                    errors[c] = {line, "Invalid number '" + std::string(badToken.first, badToken.second) + "'."};
+                    return false;
+                default:
+                    errors[c] = {line, "Expected " + std::to_string(columns) + " values, found " + std::to_string(count) + "."};
+                    return false;
+            }
+        });
+    });
+    if (firstError(errors, error)) {
+        return Matrix();
+    }
+    return result;
+}
+
+bool parseIndex(const char*& p, const char* last, size_t& value) {
+    while (p != last && isFieldSpace(*p)) {
+        ++p;
+    }
+    auto result = std::from_chars(p, last, value);
+    if (result.ec != std::errc() || result.ptr == p) {
+        return false;
+    }
+    p = result.ptr;
+    return true;
+}
+
+// Parse a Matrix Market file into (0-based) triplets. Symmetric and
+// skew-symmetric inputs are expanded to both triangles.
+bool parseMatrixMarket(const std::string& text, size_t& rows, size_t& columns,
+                       std::vector<Triplet>& triplets, std::string& error) {
+    size_t eol = text.find('\n');
+    std::istringstream banner(text.substr(0, eol));
+    std::string tag, object, layout, field, symmetry;
+    banner >> tag >> object >> layout >> field >> symmetry;
+    for (std::string* word : {&object, &layout, &field, &symmetry}) {
+        std::transform(word->begin(), word->end(), word->begin(), [](unsigned char c) { return std::tolower(c); });
+    }
+    if (tag != "%%MatrixMarket" || object != "matrix") {
+        error = "line 1: Missing %%MatrixMarket matrix banner.";
+        return false;
+    }
+    bool coordinate = layout == "coordinate";
+    bool pattern = field == "pattern";
+    bool symmetric = symmetry == "symmetric";
+    bool skew = symmetry == "skew-symmetric";
+    if ((!coordinate && layout != "array") || (field != "real" && field != "integer" && !pattern) ||
+        (!symmetric && !skew && symmetry != "general") || (!coordinate && (pattern || symmetric || skew))) {
+        error = "line 1: Unsupported Matrix Market type " + layout + " " + field + " " + symmetry + ".";
+        return false;
+    }
+
+    // Skip comments to the size line
+    size_t pos = eol == std::string::npos ? text.size() : eol + 1;
+    size_t line = 2;
+    size_t entries = 0;
+    bool haveSize = false;
+    while (pos < text.size() && !haveSize) {
+        size_t end = text.find('\n', pos);
+        end = end == std::string::npos ? text.size() : end;
+        const char* first = text.data() + pos;
+        const char* last = text.data() + end;
+        if (isDataLine(first, last)) {
+            const char* p = first;
+            if (!parseIndex(p, last, rows) || !parseIndex(p, last, columns) || (coordinate && !parseIndex(p, last, entries))) {
+                error = "line " + std::to_string(line) + ": Invalid size line.";
+                return false;
+            }
+            if (!coordinate) {
+                entries = rows * columns;
+            }
+            haveSize = true;
+        }
+        pos = end + 1;
+        ++line;
+    }
+    if (!haveSize) {
+        error = "Missing Matrix Market size line.";
+        return false;
+    }
+    pos = std::min(pos, text.size());
+
+    std::vector<size_t> bounds = chunkBounds(text, pos, chunkCount(text));
+    std::vector<size_t> lineStart, dataStart;
+    countLines(text, bounds, lineStart, dataStart, line);
+    size_t chunks = bounds.size() - 1;
+    if (dataStart[chunks] != entries) {
+        error = "Expected " + std::to_string(entries) + " entries, found " + std::to_string(dataStart[chunks]) + ".";
+        return false;
+    }
+
+    triplets.resize(entries);
+    std::vector<ChunkError> errors(chunks);
+    ThreadPool::instance().parallelFor(chunks, [&](size_t c) {
+        size_t index = dataStart[c];
+        forEachLine(text, bounds[c], bounds[c + 1], lineStart[c], [&](const char* first, const char* last, size_t lineNumber) {
+            if (!isDataLine(first, last)) {
+                return true;
+            }
+            Triplet& t = triplets[index];
+            const char* p = first;
+            if (coordinate) {
+                size_t i, j;
+                if (!parseIndex(p, last, i) || !parseIndex(p, last, j) || i == 0 || j == 0 || i > rows || j > columns) {
+                    errors[c] = {lineNumber, "Invalid or out of range index."};
+                    return false;
+                }
+                t.row = i - 1;
+                t.col = j - 1;
+            } else {
+                // Arrays list values column by column
+                t.row = index % rows;
+                t.col = index / rows;
+            }
+            t.value = 1.0f;
+            if (!pattern) {
+                while (p != last && isFieldSpace(*p)) {
+                    ++p;
+                }
+                const char* end = p;
+                while (end != last && !isFieldSpace(*end)) {
+                    ++end;
+                }
+                if (!parseNumber(p, end, t.value)) {
+                    errors[c] = {lineNumber, "Invalid number '" + std::string(p, end) + "'."};
+                    return false;
+                }
+            }
+            ++index;
+            return true;
+        });
+    });
+    if (firstError(errors, error)) {
+        return false;
+    }
+
+    if (symmetric || skew) {
+        size_t stored = triplets.size();
+        for (size_t i = 0; i < stored; ++i) {
+            Triplet t = triplets[i];
+            if (t.row != t.col) {
+                triplets.push_back({t.col, t.row, skew ? -t.value : t.value});
+            }
+        }
+    }
+    return true;
+}
+
+} // namespace textimport
+
+// Import a CSV, whitespace-separated or Matrix Market file. Matrix Market is
+// chosen by a .mtx extension or a %%MatrixMarket banner; otherwise a comma
+// in the first data line selects CSV. Returns an empty matrix on failure.
+Matrix importTextMatrix(const std::string& path, const std::string& name) {
+    std::string text, error;
+    stats::Scope scope(stats::Op::Import);
+    if (!textimport::readFile(path, text, error)) {
+        std::cerr << "Error: " << error << "\n";
+        return Matrix();
+    }
+    scope.setWork(0, text.size());
+    bool matrixMarket = text.compare(0, 14, "%%MatrixMarket") == 0 ||
+        (path.size() > 4 && path.compare(path.size() - 4, 4, ".mtx") == 0);
+
+    Matrix result;
+    if (matrixMarket) {
+        size_t rows = 0, columns = 0;
+        std::vector<textimport::Triplet> triplets;
+        if (textimport::parseMatrixMarket(text, rows, columns, triplets, error)) {
+            // Entries are applied in file order, so a repeated entry keeps its last value
+            result = Matrix(name, rows, columns);
+            FloatView target = result.view();
+            for (const textimport::Triplet& t : triplets) {
+                target(t.row, t.col) = t.value;
+            }
+        }
+    } else {
+        result = textimport::parseDelimited(text, name, error);
+    }
+    if (!error.empty()) {
+        std::cerr << "Error: " << path << ": " << error << "\n";
+        return Matrix();
+    }
+    return result;
+}
+
+// Sparse matrices
+//
+// SparseMatrix stores rows in compressed sparse row (CSR) form with column
+// indices sorted within each row. The compressed-column (CSC) form of a
+// matrix is the CSR form of its transpose, which transpose() builds in
+// O(nnz). Memory is O(rows + nnz) instead of O(rows * columns).
+
+// fastSolve switches to sparse elimination at or below this fill fraction
+const double kSparseDensity = 0.05;
+// ...but only for matrices with at least this many elements
+const size_t kSparseMinElements = 64 * 64;
+
+struct SparseEntry {
+    size_t col;
+    float value;
+};
+using SparseRow = std::vector<SparseEntry>;
+
+// dst = a - factor * b, dropping entries that cancel to zero
+void subtractScaledRow(const SparseRow& a, float factor, const SparseRow& b, SparseRow& dst) {
+    dst.clear();
+    size_t i = 0, j = 0;
+    while (i < a.size() || j < b.size()) {
+        size_t col;
+        float value;
+        if (j == b.size() || (i < a.size() && a[i].col < b[j].col)) {
+            col = a[i].col;
+            value = a[i++].value;
+        } else if (i == a.size() || b[j].col < a[i].col) {
+            col = b[j].col;
+            value = -factor * b[j++].value;
+        } else {
+            col = a[i].col;
+            value = a[i++].value - factor * b[j++].value;
+        }
+        if (value != 0.0f) {
+            dst.push_back({col, value});
+        }
+    }
+}
+
+// Gauss-Jordan reduction of an augmented matrix held as sparse rows (the last
+// column is the right-hand side). Pivot rows are chosen per column by
+// threshold partial pivoting: among rows whose entry is at least half the
+// column's largest, take the one with the fewest nonzeros to limit fill-in.
+// Columns are never permuted, so the RREF and classification are the same
+// as reduceToRrefBlocked gives. Rows come back in RREF order.
+//
+// The sweeps are sequential; the sparse kernels below are the parallel part.
+//
+// Gives up and returns false, with rows half reduced, once the forward sweep
+// has merged more than workLimit entries.
+bool reduceSparseRowsToRref(std::vector<SparseRow>& rows, size_t columns, SolutionKind& kind,
+                            size_t workLimit = std::numeric_limits<size_t>::max()) {
+    if (columns == 0) {
+        kind = SolutionKind::Unique;
+        return true;
+    }
+    const size_t unknowns = columns - 1;
+    float maxAbs = 0.0f;
+    for (const SparseRow& row : rows) {
+        for (const SparseEntry& e : row) {
+            maxAbs = std::max(maxAbs, std::fabs(e.value));
+        }
+    }
+    // Pivots and right-hand sides within tolerance count as zero, as in
+    // reduceToRrefBlocked. Fill-in is only dropped when it cancels exactly;
+    // trimming small fill costs far more accuracy than it saves in time.
+    const float tolerance = maxAbs * static_cast<float>(std::max(rows.size(), columns)) * std::numeric_limits<float>::epsilon();
+
+    // Bucket rows by leading column; elimination only ever moves a row to a later bucket
+    std::vector<std::vector<size_t>> byLead(columns);
+    std::vector<size_t> emptyRows;
+    size_t merged = 0;
+    auto bucket = [&](size_t r) {
+        if (rows[r].empty()) {
+            emptyRows.push_back(r);
+        } else {
+            byLead[rows[r][0].col].push_back(r);
+        }
+    };
+    for (size_t r = 0; r < rows.size(); ++r) {
+        SparseRow& row = rows[r];
+        row.erase(std::remove_if(row.begin(), row.end(), [](const SparseEntry& e) { return e.value == 0.0f; }), row.end());
+        bucket(r);
+    }
+
+    // Forward sweep to row echelon form
+    std::vector<size_t> pivotRows;
+    std::vector<size_t> pivotOfColumn(columns, static_cast<size_t>(-1));
+    SparseRow scratch;
+    for (size_t c = 0; c < unknowns; ++c) {
+        std::vector<size_t>& candidates = byLead[c];
+        if (candidates.empty()) {
+            continue;
+        }
+        float largest = 0.0f;
+        for (size_t r : candidates) {
+            largest = std::max(largest, std::fabs(rows[r][0].value));
+        }
+        if (largest <= tolerance) {
+            // No usable pivot: the column is zero in every remaining row
+            std::vector<size_t> stale;
+            stale.swap(candidates);
+            for (size_t r : stale) {
+                rows[r].erase(rows[r].begin());
+                bucket(r);
+            }
+            continue;
+        }
+        size_t pivot = candidates[0];
+        for (size_t r : candidates) {
+            if (std::fabs(rows[r][0].value) >= 0.5f * largest &&
+                (std::fabs(rows[pivot][0].value) < 0.5f * largest || rows[r].size() < rows[pivot].size())) {
+                pivot = r;
+            }
+        }
+        const SparseRow& pivotRow = rows[pivot];
+        for (size_t r : candidates) {
+            if (r == pivot) {
+                continue;
+            }
+            float factor = rows[r][0].value / pivotRow[0].value;
+            subtractScaledRow(rows[r], factor, pivotRow, scratch);
+            // The leading entries cancel exactly
+            if (!scratch.empty() && scratch[0].col == c) {
+                scratch.erase(scratch.begin());
+            }
+            merged += rows[r].size() + pivotRow.size();
+            rows[r].swap(scratch);
+            bucket(r);
+        }
+        pivotOfColumn[c] = pivotRows.size();
+        pivotRows.push_back(pivot);
+        candidates.clear();
+        if (merged > workLimit) {
+            return false;
+        }
+    }
+
+    // Backward sweep from the last pivot up. Reduced rows hold no pivot
+    // columns but their own, so subtracting one never creates more work.
+    const size_t rank = pivotRows.size();
+    std::vector<SparseRow> reduced(rank);
+    std::vector<float> work(columns, 0.0f);
+    std::vector<char> touched(columns, 0);
+    std::vector<size_t> touchedCols;
+    for (size_t p = rank; p-- > 0;) {
+        const SparseRow& own = rows[pivotRows[p]];
+        const size_t pivotCol = own[0].col;
+        for (const SparseEntry& e : own) {
+            work[e.col] = e.value;
+            touched[e.col] = 1;
+            touchedCols.push_back(e.col);
+        }
+        for (const SparseEntry& e : own) {
+            size_t k = e.col < unknowns ? pivotOfColumn[e.col] : static_cast<size_t>(-1);
+            if (e.col == pivotCol || k == static_cast<size_t>(-1)) {
+                continue;
+            }
+            float factor = work[e.col];
+            for (const SparseEntry& f : reduced[k]) {
+                if (!touched[f.col]) {
+                    touched[f.col] = 1;
+                    touchedCols.push_back(f.col);
+                }
+                work[f.col] -= factor * f.value;
+            }
+            work[e.col] = 0.0f;
+        }
+
+        std::sort(touchedCols.begin(), touchedCols.end());
+        float pivotValue = work[pivotCol];
+        SparseRow& out = reduced[p];
+        for (size_t col : touchedCols) {
+            if (col == pivotCol) {
+                out.push_back({col, 1.0f});
+            } else if (work[col] != 0.0f && (col >= unknowns || pivotOfColumn[col] == static_cast<size_t>(-1))) {
+                out.push_back({col, work[col] / pivotValue});
+            }
+            work[col] = 0.0f;
+            touched[col] = 0;
+        }
+        touchedCols.clear();
+    }
+
+    // Rows with only a right-hand side left are the evidence of inconsistency
+    bool inconsistent = false;
+    for (size_t r : byLead[unknowns]) {
+        inconsistent = inconsistent || std::fabs(rows[r][0].value) > tolerance;
+    }
+    std::vector<SparseRow> result;
+    result.reserve(rows.size());
+    for (SparseRow& row : reduced) {
+        result.push_back(std::move(row));
+    }
+    for (size_t r : byLead[unknowns]) {
+        result.push_back(std::move(rows[r]));
+    }
+    for (size_t i = 0; i < emptyRows.size(); ++i) {
+        result.emplace_back();
+    }
+    rows.swap(result);
+
+    if (inconsistent) {
+        kind = SolutionKind::Inconsistent;
+    } else {
+        kind = rank < unknowns ? SolutionKind::Infinite : SolutionKind::Unique;
+    }
+    return true;
+}
+
+class SparseMatrix {
+public:
+    SparseMatrix() : name(""), rows(0), columns(0), rowStart(1, 0) {}
+    SparseMatrix(const std::string& name, size_t rws, size_t clmns)
+        : name(name), rows(rws), columns(clmns), rowStart(rws + 1, 0) {}
+
+    // Conversions. fromTriplets keeps the last value for repeated positions.
+    static SparseMatrix fromDense(const Matrix& dense);
+    static SparseMatrix fromTriplets(const std::string& name, size_t rws, size_t clmns,
+                                     const std::vector<textimport::Triplet>& triplets);
+    static SparseMatrix fromRows(const std::string& name, size_t clmns, const std::vector<SparseRow>& sparseRows);
+    Matrix toDense() const;
+    std::vector<SparseRow> toRows() const;
+
+    float getElement(size_t row, size_t col) const;
+    size_t nonZeros() const { return values.size(); }
+    double density() const {
+        return rows * columns == 0 ? 0.0 : static_cast<double>(values.size()) / (static_cast<double>(rows) * columns);
+    }
+    bool isEmpty() const { return rows == 0 || columns == 0; }
+
+    SparseMatrix transpose() const;
+    void multiplyVector(const float* x, float* y) const; // y = A * x
+    Matrix multiply(const Matrix& other) const;          // Sparse * dense
+    SparseMatrix multiply(const SparseMatrix& other) const;
+    SparseMatrix add(const SparseMatrix& other) const;
+    Matrix add(const Matrix& other) const;
+
+    // Reduce an augmented system to RREF in place
+    SolutionKind solve();
+
+    // Nonzeros as (row, column) value lines, summarized past kPrintSummaryThreshold
+    void print(bool full = false) const;
+
+    std::string getName() const { return name; }
+    void setName(const std::string& newName) { name = newName; }
+    size_t rowCount() const { return rows; }
+    size_t columnCount() const { return columns; }
+    // Bytes held by the CSR arrays
+    size_t memoryBytes() const {
+        return rowStart.size() * sizeof(size_t) + colIndex.size() * sizeof(size_t) + values.size() * sizeof(float);
+    }
+
+    // Raw CSR arrays
+    const std::vector<size_t>& rowOffsets() const { return rowStart; }
+    const std::vector<size_t>& columnIndices() const { return colIndex; }
+    const std::vector<float>& nonZeroValues() const { return values; }
+
+private:
+    std::string name;
+    size_t rows;
+    size_t columns;
+    std::vector<size_t> rowStart; // rows + 1 offsets into colIndex/values
+    std::vector<size_t> colIndex;
+    std::vector<float> values;
+
+    // Build rows [0, rows) in parallel chunks: rowFn(r, out) appends row r's
+    // sorted entries to out
+    template <typename RowFn>
+    static SparseMatrix build(const std::string& name, size_t rws, size_t clmns, size_t costPerRow, RowFn rowFn);
+};
+
+template <typename RowFn>
+SparseMatrix SparseMatrix::build(const std::string& name, size_t rws, size_t clmns, size_t costPerRow, RowFn rowFn) {
+    // Each chunk fills its own rows, then the chunks are stitched together in order
+    std::vector<std::pair<size_t, std::vector<SparseRow>>> chunks;
+    std::mutex chunksMutex;
+    parallelRange(rws, costPerRow, [&](size_t begin, size_t end) {
+        std::vector<SparseRow> local(end - begin);
+        for (size_t r = begin; r < end; ++r) {
+            rowFn(r, local[r - begin]);
+        }
+        std::lock_guard<std::mutex> lock(chunksMutex);
+        chunks.emplace_back(begin, std::move(local));
+    });
+    std::sort(chunks.begin(), chunks.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    SparseMatrix result(name, rws, clmns);
+    size_t r = 0;
+    for (const auto& chunk : chunks) {
+        for (const SparseRow& row : chunk.second) {
+            for (const SparseEntry& e : row) {
+                result.colIndex.push_back(e.col);
+                result.values.push_back(e.value);
+            }
+            result.rowStart[++r] = result.values.size();
+        }
+    }
+    return result;
+}
+
+SparseMatrix SparseMatrix::fromDense(const Matrix& dense) {
+    ConstFloatView v = dense.view();
+    return build(dense.getName(), v.rows, v.columns, v.columns, [&](size_t r, SparseRow& out) {
+        for (size_t c = 0; c < v.columns; ++c) {
+            if (v(r, c) != 0.0f) {
+                out.push_back({c, v(r, c)});
+            }
+        }
+    });
+}
+
+SparseMatrix SparseMatrix::fromTriplets(const std::string& name, size_t rws, size_t clmns,
+                                        const std::vector<textimport::Triplet>& triplets) {
+    // Counting sort by row; a stable sort by column then keeps file order for repeats
+    SparseMatrix result(name, rws, clmns);
+    for (const textimport::Triplet& t : triplets) {
+        ++result.rowStart[t.row + 1];
+    }
+    for (size_t r = 0; r < rws; ++r) {
+        result.rowStart[r + 1] += result.rowStart[r];
+    }
+    std::vector<size_t> next(result.rowStart.begin(), result.rowStart.end() - 1);
+    std::vector<SparseEntry> entries(triplets.size());
+    for (const textimport::Triplet& t : triplets) {
+        entries[next[t.row]++] = {t.col, t.value};
+    }
+    std::vector<SparseRow> sparseRows(rws);
+    for (size_t r = 0; r < rws; ++r) {
+        SparseRow& row = sparseRows[r];
+        row.assign(entries.begin() + static_cast<ptrdiff_t>(result.rowStart[r]), entries.begin() + static_cast<ptrdiff_t>(result.rowStart[r + 1]));
+        std::stable_sort(row.begin(), row.end(), [](const SparseEntry& a, const SparseEntry& b) { return a.col < b.col; });
+        // Keep the last of any repeated column, and drop explicit zeros
+        SparseRow unique;
+        for (size_t i = 0; i < row.size(); ++i) {
+            if ((i + 1 == row.size() || row[i + 1].col != row[i].col) && row[i].value != 0.0f) {
+                unique.push_back(row[i]);
+            }
+        }
+        row.swap(unique);
+    }
+    return fromRows(name, clmns, sparseRows);
+}
+
+SparseMatrix SparseMatrix::fromRows(const std::string& name, size_t clmns, const std::vector<SparseRow>& sparseRows) {
+    SparseMatrix result(name, sparseRows.size(), clmns);
+    for (size_t r = 0; r < sparseRows.size(); ++r) {
+        for (const SparseEntry& e : sparseRows[r]) {
+            result.colIndex.push_back(e.col);
+            result.values.push_back(e.value);
+        }
+        result.rowStart[r + 1] = result.values.size();
+    }
+    return result;
+}
+
+Matrix SparseMatrix::toDense() const {
+    Matrix dense(name, rows, columns);
+    FloatView v = dense.view();
+    parallelRange(rows, std::max<size_t>(1, values.size() / std::max<size_t>(1, rows)), [&](size_t begin, size_t end) {
+        for (size_t r = begin; r < end; ++r) {
+            for (size_t k = rowStart[r]; k < rowStart[r + 1]; ++k) {
+                v(r, colIndex[k]) = values[k];
+            }
+        }
+    });
+    return dense;
+}
+
+std::vector<SparseRow> SparseMatrix::toRows() const {
+    std::vector<SparseRow> result(rows);
+    for (size_t r = 0; r < rows; ++r) {
+        for (size_t k = rowStart[r]; k < rowStart[r + 1]; ++k) {
+            result[r].push_back({colIndex[k], values[k]});
+        }
+    }
+    return result;
+}
+
+float SparseMatrix::getElement(size_t row, size_t col) const {
+    if (row >= rows || col >= columns) {
+        return -1.0f; // Error value, as for Matrix
+    }
+    auto first = colIndex.begin() + static_cast<ptrdiff_t>(rowStart[row]);
+    auto last = colIndex.begin() + static_cast<ptrdiff_t>(rowStart[row + 1]);
+    auto it = std::lower_bound(first, last, col);
+    return it != last && *it == col ? values[static_cast<size_t>(it - colIndex.begin())] : 0.0f;
+}
+
+SparseMatrix SparseMatrix::transpose() const {
+    SparseMatrix result(name, columns, rows);
+    for (size_t c : colIndex) {
+        ++result.rowStart[c + 1];
+    }
+    for (size_t c = 0; c < columns; ++c) {
+        result.rowStart[c + 1] += result.rowStart[c];
+    }
+    result.colIndex.resize(values.size());
+    result.values.resize(values.size());
+    std::vector<size_t> next(result.rowStart.begin(), result.rowStart.end() - 1);
+    // Walking rows in order leaves each transposed row sorted
+    for (size_t r = 0; r < rows; ++r) {
+        for (size_t k = rowStart[r]; k < rowStart[r + 1]; ++k) {
+            size_t dst = next[colIndex[k]]++;
+            result.colIndex[dst] = r;
+            result.values[dst] = values[k];
+        }
+    }
+    return result;
+}
+
+void SparseMatrix::multiplyVector(const float* x, float* y) const {
+    parallelRange(rows, std::max<size_t>(1, values.size() / std::max<size_t>(1, rows)), [&](size_t begin, size_t end) {
+        for (size_t r = begin; r < end; ++r) {
+            float sum = 0.0f;
+            for (size_t k = rowStart[r]; k < rowStart[r + 1]; ++k) {
+                sum += values[k] * x[colIndex[k]];
+            }
+            y[r] = sum;
+        }
+    });
+}
+
+Matrix SparseMatrix::multiply(const Matrix& other) const {
+    ConstFloatView b = other.view();
+    if (columns != b.rows) {
+        std::cerr << "Error: Number of columns in the first matrix must be equal to the number of rows in the second matrix.\n";
+        return Matrix(); // Return an empty matrix
+    }
+    stats::Scope scope(stats::Op::SparseMultiply, 2 * values.size() * b.columns,
+                       memoryBytes() + 2 * b.rows * b.columns * sizeof(float));
+    Matrix result(name, rows, b.columns);
+    FloatView c = result.view();
+    size_t perRow = std::max<size_t>(1, values.size() / std::max<size_t>(1, rows)) * b.columns;
+    parallelRange(rows, perRow, [&](size_t begin, size_t end) {
+        for (size_t r = begin; r < end; ++r) {
+            for (size_t k = rowStart[r]; k < rowStart[r + 1]; ++k) {
+                addScaledRow(values[k], b.row(colIndex[k]), c.row(r));
+            }
+        }
+    });
+    return result;
+}
+
+SparseMatrix SparseMatrix::multiply(const SparseMatrix& other) const {
+    if (columns != other.rows) {
+        std::cerr << "Error: Number of columns in the first matrix must be equal to the number of rows in the second matrix.\n";
+        return SparseMatrix();
+    }
+    stats::Scope scope(stats::Op::SparseMultiply);
+    if (scope.isActive()) {
+        // Every stored a_ik meets each stored entry of row k of other
+        uint64_t products = 0;
+        for (size_t col : colIndex) {
+            products += other.rowStart[col + 1] - other.rowStart[col];
+        }
+        scope.setWork(2 * products, memoryBytes() + other.memoryBytes());
+    }
+
+    // Gustavson's row-by-row product with a dense accumulator per chunk
+    const size_t n = other.columns;
+    return build(name, rows, n, std::max<size_t>(1, values.size() / std::max<size_t>(1, rows)) * 16, [&](size_t r, SparseRow& out) {
+        // Scratch is left zeroed after every row, so it only needs sizing once per thread
+        thread_local std::vector<float> work;
+        thread_local std::vector<char> seen;
+        thread_local std::vector<size_t> cols;
+        if (work.size() != n) {
+            work.assign(n, 0.0f);
+            seen.assign(n, 0);
+        }
+        cols.clear();
+        for (size_t k = rowStart[r]; k < rowStart[r + 1]; ++k) {
+            size_t mid = colIndex[k];
+            for (size_t q = other.rowStart[mid]; q < other.rowStart[mid + 1]; ++q) {
+                size_t col = other.colIndex[q];
+                if (!seen[col]) {
+                    seen[col] = 1;
+                    cols.push_back(col);
+                }
+                work[col] += values[k] * other.values[q];
+            }
+        }
+        std::sort(cols.begin(), cols.end());
+        for (size_t col : cols) {
+            if (work[col] != 0.0f) {
+                out.push_back({col, work[col]});
+            }
+            work[col] = 0.0f;
+            seen[col] = 0;
+        }
+    });
+}
+
+SparseMatrix SparseMatrix::add(const SparseMatrix& other) const {
+    if (rows != other.rows || columns != other.columns) {
+        std::cerr << "Error: Matrices must have the same dimensions to be added.\n";
+        return SparseMatrix();
+    }
+    stats::Scope scope(stats::Op::SparseAdd, values.size() + other.values.size(), memoryBytes() + other.memoryBytes());
+    return build(name, rows, columns, 8, [&](size_t r, SparseRow& out) {
+        size_t i = rowStart[r], j = other.rowStart[r];
+        while (i < rowStart[r + 1] || j < other.rowStart[r + 1]) {
+            SparseEntry e;
+            if (j == other.rowStart[r + 1] || (i < rowStart[r + 1] && colIndex[i] < other.colIndex[j])) {
+                e = {colIndex[i], values[i]};
+                ++i;
+            } else if (i == rowStart[r + 1] || other.colIndex[j] < colIndex[i]) {
+                e = {other.colIndex[j], other.values[j]};
+                ++j;
+            } else {
+                e = {colIndex[i], values[i] + other.values[j]};
+                ++i;
+                ++j;
+            }
+            if (e.value != 0.0f) {
+                out.push_back(e);
+            }
+        }
+    });
+}
+
+Matrix SparseMatrix::add(const Matrix& other) const {
+    ConstFloatView b = other.view();
+    if (rows != b.rows || columns != b.columns) {
+        std::cerr << "Error: Matrices must have the same dimensions to be added.\n";
+        return Matrix(); // Return an empty matrix
+    }
+    stats::Scope scope(stats::Op::SparseAdd, values.size(), memoryBytes() + 2 * rows * columns * sizeof(float));
+    Matrix result = other.duplicate(name);
+    FloatView c = result.view();
+    for (size_t r = 0; r < rows; ++r) {
+        for (size_t k = rowStart[r]; k < rowStart[r + 1]; ++k) {
+            c(r, colIndex[k]) += values[k];
+        }
+    }
+    return result;
+}
+
+// Dense * sparse, for when only the right operand is sparse
+Matrix multiplyDenseSparse(const Matrix& a, const SparseMatrix& b) {
+    ConstFloatView av = a.view();
+    if (av.columns != b.rowCount()) {
+        std::cerr << "Error: Number of columns in the first matrix must be equal to the number of rows in the second matrix.\n";
+        return Matrix(); // Return an empty matrix
+    }
+    stats::Scope scope(stats::Op::SparseMultiply, 2 * av.rows * b.nonZeros(),
+                       b.memoryBytes() + (av.rows * av.columns + av.rows * b.columnCount()) * sizeof(float));
+    Matrix result(a.getName(), av.rows, b.columnCount());
+    FloatView c = result.view();
+    const std::vector<size_t>& start = b.rowOffsets();
+    const std::vector<size_t>& cols = b.columnIndices();
+    const std::vector<float>& vals = b.nonZeroValues();
+    parallelRange(av.rows, std::max<size_t>(1, vals.size()), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            for (size_t k = 0; k < av.columns; ++k) {
+                float aik = av(i, k);
+                if (aik == 0.0f) {
+                    continue;
+                }
+                for (size_t q = start[k]; q < start[k + 1]; ++q) {
+                    c(i, cols[q]) += aik * vals[q];
+                }
+            }
+        }
+    });
+    return result;
+}
+
+SolutionKind SparseMatrix::solve() {
+    stats::Scope scope(stats::Op::SparseSolve, 0, 2 * memoryBytes());
+    std::vector<SparseRow> sparseRows = toRows();
+    SolutionKind kind;
+    reduceSparseRowsToRref(sparseRows, columns, kind);
+    *this = fromRows(name, columns, sparseRows);
+    return kind;
+}
+
+void SparseMatrix::print(bool full) const {
+    OutputBuffer out(std::cout);
+    out.put("Sparse matrix " + name + " (");
+    out.putIndex(rows);
+    out.put('x');
+    out.putIndex(columns);
+    out.put(", ", 2);
+    out.putIndex(values.size());
+    out.put(" nonzeros):\n", 12);
+    // Summarized, only the first and last few nonzeros are listed
+    const size_t gap = printGapStart(values.size(), !full && values.size() > kPrintSummaryThreshold);
+    size_t r = 0;
+    for (size_t k = 0; k < values.size(); ++k) {
+        if (k == gap) {
+            out.put("...\n", 4);
+            k = values.size() - kPrintEdgeItems;
+        }
+        while (rowStart[r + 1] <= k) {
+            ++r;
+        }
+        out.put('(');
+        out.putIndex(r + 1);
+        out.put(", ", 2);
+        out.putIndex(colIndex[k] + 1);
+        out.put(")\t", 2);
+        out.putFloat(values[k]);
+        out.put('\n');
+    }
+}
+
+// Read a Matrix Market file straight into CSR, never allocating the dense matrix
+SparseMatrix importSparseMatrix(const std::string& path, const std::string& name) {
+    std::string text, error;
+    size_t rows = 0, columns = 0;
+    std::vector<textimport::Triplet> triplets;
+    stats::Scope scope(stats::Op::Import);
+    if (!textimport::readFile(path, text, error)) {
+        std::cerr << "Error: " << error << "\n";
+        return SparseMatrix();
+    }
+    scope.setWork(0, text.size());
+    if (!textimport::parseMatrixMarket(text, rows, columns, triplets, error)) {
+        std::cerr << "Error: " << path << ": " << error << "\n";
+        return SparseMatrix();
+    }
+    return SparseMatrix::fromTriplets(name, rows, columns, triplets);
+}
+
+SolutionKind Matrix::fastSolve() {
+    stats::Scope scope(stats::Op::FastSolve, stats::eliminationFlops(rows, columns), 2 * rows * columns * sizeof(float));
+    if (rows * columns >= kSparseMinElements) {
+        // Count nonzeros, stopping as soon as the matrix is clearly dense
+        size_t limit = static_cast<size_t>(kSparseDensity * static_cast<double>(rows * columns));
+        size_t nonZeros = 0;
+        for (size_t r = 0; r < rows && nonZeros <= limit; ++r) {
+            const float* rowData = rowPtr(r);
+            for (size_t c = 0; c < columns; ++c) {
+                nonZeros += rowData[c] != 0.0f ? 1 : 0;
+            }
+        }
+        // Fill-in can make sparse elimination slower than the dense kernel,
+        // which retires hundreds of flops for each entry a merge moves. Give
+        // up once the merges pass about 1/1000 of the dense rows^2 * columns.
+        SolutionKind kind;
+        std::vector<SparseRow> sparseRows;
+        if (nonZeros <= limit) {
+            sparseRows = SparseMatrix::fromDense(*this).toRows();
+        }
+        if (nonZeros <= limit && reduceSparseRowsToRref(sparseRows, columns, kind, rows * rows / 1024 * columns)) {
+            FloatView v = view();
+            for (size_t r = 0; r < rows; ++r) {
+                std::fill(&v(r, 0), &v(r, 0) + columns, 0.0f);
+                for (const SparseEntry& e : sparseRows[r]) {
+                    v(r, e.col) = e.value;
+                }
+            }
+            return kind;
+        }
+    }
+    return reduceToRrefBlocked(view());
+}
+
+// Print rank, determinant and singularity from the (cached) factors
+void reportFactorization(const Matrix& m) {
+    std::shared_ptr<const LUFactorization> lu = m.factorization();
+    std::cout << "LU factorization of " << m.getName() << ": rank " << lu->rank();
+    if (lu->isSingular()) {
+        std::cout << ", singular.\n";
+    } else {
+        std::cout << ", determinant " << lu->determinant() << ".\n";
+    }
+}
+
+// Iterative solvers
+//
+// Solve A x = b for an augmented system [A | b], dense or sparse, reading A
+// only a row or a matrix-vector product at a time. An iteration costs
+// O(nonzeros) and the extra memory is a handful of vectors, plus the restart
+// basis for GMRES and a copy of A's pattern for ILU(0), so large well
+// conditioned systems finish long before elimination would. Vectors are held
+// in double, so the residual can go well below float precision.
+//
+// - Conjugate gradient needs A symmetric positive definite.
+// - GMRES, restarted every Options::restart steps, handles any nonsingular A.
+// - Jacobi and Gauss-Seidel iterations need A diagonally dominant (or, for
+//   Gauss-Seidel, SPD) and take no preconditioner.
+//
+// CG and GMRES accept a Jacobi (diagonal) or ILU(0) preconditioner. ILU(0)
+// is LU restricted to A's nonzero pattern: cheap for sparse systems, but on a
+// fully dense one it costs as much as a complete factorization.
+//
+// Every method stops once ||b - A x|| <= tolerance * ||b|| or after
+// maxIterations (GMRES counts inner steps), starting from x = 0.
+namespace iterative {
+
+enum class Method { ConjugateGradient, Gmres, Jacobi, GaussSeidel };
+enum class Preconditioner { None, Jacobi, Ilu0 };
+
+struct Options {
+    Method method = Method::ConjugateGradient;
+    Preconditioner preconditioner = Preconditioner::None;
+    double tolerance = 1e-6;
+    size_t maxIterations = 1000;
+    size_t restart = 30;
+};
+
+struct Result {
+    std::vector<double> x;
+    size_t iterations = 0;
+    double residual = 0.0; // ||b - A x|| / ||b|| for the returned x
+    bool converged = false;
+    std::string failure;   // Set when the method could not run or broke down
+};
+
+bool parseMethod(const std::string& text, Method& method) {
+    if (text == "cg") {
+        method = Method::ConjugateGradient;
+    } else if (text == "gmres") {
+        method = Method::Gmres;
+    } else if (text == "jacobi") {
+        method = Method::Jacobi;
+    } else if (text == "gaussseidel" || text == "gs") {
+        method = Method::GaussSeidel;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool parsePreconditioner(const std::string& text, Preconditioner& preconditioner) {
+    if (text == "none") {
+        preconditioner = Preconditioner::None;
+    } else if (text == "jacobi") {
+        preconditioner = Preconditioner::Jacobi;
+    } else if (text == "ilu0") {
+        preconditioner = Preconditioner::Ilu0;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// The coefficient part of an augmented system, read in place
+class System {
+public:
+    explicit System(ConstFloatView dense) : dense(dense), n(dense.rows) {}
+    explicit System(const SparseMatrix& sparse) : sparse(&sparse), n(sparse.rowCount()) {}
+
+    size_t size() const { return n; }
+    bool isSquare() const { return (sparse ? sparse->columnCount() : dense.columns) == n + 1; }
+    size_t nonZeros() const { return sparse ? sparse->nonZeros() : n * n; }
+
+    // Call f(col, value) for each stored entry of row r of A, in column order
+    template <typename F>
+    void forEachInRow(size_t r, F f) const {
+        if (sparse) {
+            const std::vector<size_t>& cols = sparse->columnIndices();
+            const std::vector<float>& vals = sparse->nonZeroValues();
+            for (size_t k = sparse->rowOffsets()[r]; k < sparse->rowOffsets()[r + 1] && cols[k] < n; ++k) {
+                f(cols[k], vals[k]);
+            }
+        } else {
+            const float* row = dense.row(r).data;
+            for (size_t c = 0; c < n; ++c) {
+                f(c, row[c]);
+            }
+        }
+    }
+
+    std::vector<double> rightHandSide() const {
+        std::vector<double> b(n);
+        for (size_t r = 0; r < n; ++r) {
+            b[r] = sparse ? sparse->getElement(r, n) : dense(r, n);
+        }
+        return b;
+    }
+
+    std::vector<double> diagonal() const {
+        std::vector<double> d(n, 0.0);
+        for (size_t r = 0; r < n; ++r) {
+            forEachInRow(r, [&](size_t c, float v) {
+                if (c == r) {
+                    d[r] = v;
+                }
+            });
+        }
+        return d;
+    }
+
+    // y = A x
+    void multiply(const double* x, double* y) const {
+        parallelRange(n, nonZeros() / std::max<size_t>(1, n) + 1, [&](size_t begin, size_t end) {
+            for (size_t r = begin; r < end; ++r) {
+                double sum = 0.0;
+                forEachInRow(r, [&](size_t c, float v) { sum += v * x[c]; });
+                y[r] = sum;
+            }
+        });
+    }
+
+private:
+    ConstFloatView dense;
+    const SparseMatrix* sparse = nullptr;
+    size_t n;
+};
+
+double dot(const std::vector<double>& a, const std::vector<double>& b) {
+    double sum = 0.0;
+    for (size_t i = 0; i < a.size(); ++i) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+double norm(const std::vector<double>& v) {
+    return std::sqrt(dot(v, v));
+}
+
+// ||b - A x|| / ||b||
+double relativeResidual(const System& a, const std::vector<double>& b, const std::vector<double>& x, double bNorm) {
+    std::vector<double> r(b.size());
+    a.multiply(x.data(), r.data());
+    for (size_t i = 0; i < r.size(); ++i) {
+        r[i] = b[i] - r[i];
+    }
+    return norm(r) / bNorm;
+}
+
+// z = M^-1 r
+class PreconditionerSolve {
+public:
+    // Returns false and sets failure if M would be singular
+    bool build(const System& a, Preconditioner kind, std::string& failure) {
+        this->kind = kind;
+        const size_t n = a.size();
+        if (kind == Preconditioner::Jacobi) {
+            inverseDiagonal = a.diagonal();
+            for (double& d : inverseDiagonal) {
+                if (d == 0.0) {
+                    failure = "Jacobi preconditioning needs a nonzero diagonal.";
+                    return false;
+                }
+                d = 1.0 / d;
+            }
+        } else if (kind == Preconditioner::Ilu0) {
+            // Copy A's nonzero pattern, then factor in place (IKJ order),
+            // dropping every update that falls outside the pattern
+            start.assign(1, 0);
+            for (size_t r = 0; r < n; ++r) {
+                a.forEachInRow(r, [&](size_t c, float v) {
+                    if (v != 0.0f) {
+                        col.push_back(c);
+                        lu.push_back(v);
+                    }
+                });
+                start.push_back(col.size());
+            }
+            diag.assign(n, 0);
+            std::vector<size_t> position(n, SIZE_MAX);
+            for (size_t i = 0; i < n; ++i) {
+                for (size_t k = start[i]; k < start[i + 1]; ++k) {
+                    position[col[k]] = k;
+                }
+                size_t k = start[i];
+                for (; k < start[i + 1] && col[k] < i; ++k) {
+                    size_t p = col[k];
+                    lu[k] /= lu[diag[p]];
+                    for (size_t q = diag[p] + 1; q < start[p + 1]; ++q) {
+                        if (position[col[q]] != SIZE_MAX) {
+                            lu[position[col[q]]] -= lu[k] * lu[q];
+                        }
+                    }
+                }
+                for (size_t q = start[i]; q < start[i + 1]; ++q) {
+                    position[col[q]] = SIZE_MAX;
+                }
+                if (k == start[i + 1] || col[k] != i || lu[k] == 0.0) {
+                    failure = "ILU(0) hit a zero pivot in row " + std::to_string(i + 1) + ".";
+                    return false;
+                }
+                diag[i] = k;
+            }
+        }
+        return true;
+    }
+
+    void apply(const std::vector<double>& r, std::vector<double>& z) const {
+        const size_t n = r.size();
+        if (kind == Preconditioner::None) {
+            z = r;
+        } else if (kind == Preconditioner::Jacobi) {
+            for (size_t i = 0; i < n; ++i) {
+                z[i] = r[i] * inverseDiagonal[i];
+            }
+        } else {
+            // Unit lower triangular L, then U
+            for (size_t i = 0; i < n; ++i) {
+                double sum = r[i];
+                for (size_t k = start[i]; k < diag[i]; ++k) {
+                    sum -= lu[k] * z[col[k]];
+                }
+                z[i] = sum;
+            }
+            for (size_t i = n; i-- > 0;) {
+                double sum = z[i];
+                for (size_t k = diag[i] + 1; k < start[i + 1]; ++k) {
+                    sum -= lu[k] * z[col[k]];
+                }
+                z[i] = sum / lu[diag[i]];
+            }
+        }
+    }
+
+private:
+    Preconditioner kind = Preconditioner::None;
+    std::vector<double> inverseDiagonal;
+    std::vector<size_t> start, col, diag; // ILU(0) factors in CSR over A's pattern
+    std::vector<double> lu;
+};
+
+template <typename Report>
+void conjugateGradient(const System& a, const Options& options, const PreconditionerSolve& m,
+                       const std::vector<double>& b, double bNorm, Result& result, Report report) {
+    const size_t n = a.size();
+    std::vector<double>& x = result.x;
+    std::vector<double> r = b, z(n), p(n), ap(n);
+    m.apply(r, z);
+    p = z;
+    double rz = dot(r, z);
+    while (result.iterations < options.maxIterations) {
+        a.multiply(p.data(), ap.data());
+        double pap = dot(p, ap);
+        if (!(pap > 0.0)) {
+            result.failure = "The matrix is not positive definite; try gmres.";
+            return;
+        }
+        double alpha = rz / pap;
+        for (size_t i = 0; i < n; ++i) {
+            x[i] += alpha * p[i];
+            r[i] -= alpha * ap[i];
+        }
+        double residual = norm(r) / bNorm;
+        report(++result.iterations, residual);
+        if (residual <= options.tolerance) {
+            return;
+        }
+        m.apply(r, z);
+        double rzNext = dot(r, z);
+        double beta = rzNext / rz;
+        rz = rzNext;
+        for (size_t i = 0; i < n; ++i) {
+            p[i] = z[i] + beta * p[i];
+        }
+    }
+}
+
+// Right preconditioned, so the residual it tracks is the true one
+template <typename Report>
+void gmres(const System& a, const Options& options, const PreconditionerSolve& m,
+           const std::vector<double>& b, double bNorm, Result& result, Report report) {
+    const size_t n = a.size();
+    const size_t restart = std::max<size_t>(1, std::min(options.restart, n));
+    std::vector<double>& x = result.x;
+    std::vector<std::vector<double>> v(restart + 1, std::vector<double>(n));
+    std::vector<std::vector<double>> h(restart + 1, std::vector<double>(restart, 0.0));
+    std::vector<double> cs(restart), sn(restart), g(restart + 1), y(restart), w(n), z(n);
+
+    while (result.iterations < options.maxIterations) {
+        a.multiply(x.data(), w.data());
+        for (size_t i = 0; i < n; ++i) {
+            v[0][i] = b[i] - w[i];
+        }
+        double beta = norm(v[0]);
+        if (beta / bNorm <= options.tolerance) {
+            return;
+        }
+        for (double& e : v[0]) {
+            e /= beta;
+        }
+        std::fill(g.begin(), g.end(), 0.0);
+        g[0] = beta;
+
+        size_t steps = 0;
+        bool done = false;
+        for (size_t j = 0; j < restart && result.iterations < options.maxIterations && !done; ++j) {
+            // Arnoldi step with modified Gram-Schmidt
+            m.apply(v[j], z);
+            a.multiply(z.data(), w.data());
+            for (size_t i = 0; i <= j; ++i) {
+                h[i][j] = dot(w, v[i]);
+                for (size_t k = 0; k < n; ++k) {
+                    w[k] -= h[i][j] * v[i][k];
+                }
+            }
+            double next = norm(w);
+            if (next > 0.0) {
+                for (size_t k = 0; k < n; ++k) {
+                    v[j + 1][k] = w[k] / next;
+                }
+            }
+
+            // Keep H upper triangular with Givens rotations
+            for (size_t i = 0; i < j; ++i) {
+                double t = cs[i] * h[i][j] + sn[i] * h[i + 1][j];
+                h[i + 1][j] = -sn[i] * h[i][j] + cs[i] * h[i + 1][j];
+                h[i][j] = t;
+            }
+            double radius = std::hypot(h[j][j], next);
+            if (radius == 0.0) {
+                result.failure = "GMRES broke down; the matrix is singular.";
+                return;
+            }
+            cs[j] = h[j][j] / radius;
+            sn[j] = next / radius;
+            h[j][j] = radius;
+            g[j + 1] = -sn[j] * g[j];
+            g[j] = cs[j] * g[j];
+
+            steps = j + 1;
+            double residual = std::fabs(g[j + 1]) / bNorm;
+            report(++result.iterations, residual);
+            done = residual <= options.tolerance || next == 0.0;
+        }
+
+        // x += M^-1 V y, with H y = g solved by back substitution
+        for (size_t i = steps; i-- > 0;) {
+            double sum = g[i];
+            for (size_t k = i + 1; k < steps; ++k) {
+                sum -= h[i][k] * y[k];
+            }
+            y[i] = sum / h[i][i];
+        }
+        std::fill(w.begin(), w.end(), 0.0);
+        for (size_t i = 0; i < steps; ++i) {
+            for (size_t k = 0; k < n; ++k) {
+                w[k] += y[i] * v[i][k];
+            }
+        }
+        m.apply(w, z);
+        for (size_t k = 0; k < n; ++k) {
+            x[k] += z[k];
+        }
+        if (done) {
+            return;
+        }
+    }
+}
+
+// Jacobi updates every x_r from the previous iterate, so rows run in
+// parallel; Gauss-Seidel uses each new x_r at once and sweeps in order.
+// Jacobi's sweep forms A x for the previous iterate anyway, so its residual
+// comes free and is checked one sweep late. Gauss-Seidel would need an extra
+// A x for it, so it checks every kResidualInterval sweeps and at the last.
+constexpr size_t kResidualInterval = 8;
+
+template <typename Report>
+void stationary(const System& a, const Options& options, const std::vector<double>& b, double bNorm,
+                Result& result, Report report) {
+    const size_t n = a.size();
+    std::vector<double>& x = result.x;
+    std::vector<double> d = a.diagonal();
+    if (std::find(d.begin(), d.end(), 0.0) != d.end()) {
+        result.failure = "Jacobi and Gauss-Seidel need a nonzero diagonal.";
+        return;
+    }
+    std::vector<double> next(n), r(n);
+    while (true) {
+        bool checked = false;
+        double residual = 0.0;
+        if (options.method == Method::Jacobi) {
+            a.multiply(x.data(), r.data());
+            double sum = 0.0;
+            for (size_t i = 0; i < n; ++i) {
+                sum += (b[i] - r[i]) * (b[i] - r[i]);
+            }
+            residual = std::sqrt(sum) / bNorm;
+            checked = result.iterations > 0;
+        } else if (result.iterations > 0 && (result.iterations % kResidualInterval == 0 ||
+                                              result.iterations == options.maxIterations)) {
+            residual = relativeResidual(a, b, x, bNorm);
+            checked = true;
+        }
+        if (checked) {
+            report(result.iterations, residual);
+            if (!std::isfinite(residual)) {
+                result.failure = "The iteration diverged; the matrix is probably not diagonally dominant.";
+                return;
+            }
+            if (residual <= options.tolerance) {
+                return;
+            }
+        }
+        if (result.iterations >= options.maxIterations) {
+            return;
+        }
+
+        ++result.iterations;
+        if (options.method == Method::Jacobi) {
+            parallelRange(n, 1, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    next[i] = x[i] + (b[i] - r[i]) / d[i];
+                }
+            });
+            x.swap(next);
+        } else {
+            for (size_t i = 0; i < n; ++i) {
+                double sum = 0.0;
+                a.forEachInRow(i, [&](size_t c, float v) { sum += v * x[c]; });
+                x[i] += (b[i] - sum) / d[i];
+            }
+        }
+    }
+}
+
+// report(iteration, relativeResidual) is called after every iteration, or for
+// Gauss-Seidel after every iteration whose residual is checked
+template <typename Report>
+Result solve(const System& a, const Options& options, Report report) {
+    Result result;
+    if (!a.isSquare()) {
+        result.failure = "Iterative solvers need an n x (n + 1) augmented system.";
+        return result;
+    }
+    const size_t n = a.size();
+    stats::Scope scope(stats::Op::IterativeSolve);
+    std::vector<double> b = a.rightHandSide();
+    result.x.assign(n, 0.0);
+    double bNorm = norm(b);
+    if (bNorm == 0.0) {
+        result.converged = true; // x = 0 is exact
+        return result;
+    }
+
+    PreconditionerSolve m;
+    bool usesPreconditioner = options.method == Method::ConjugateGradient || options.method == Method::Gmres;
+    if (usesPreconditioner && !m.build(a, options.preconditioner, result.failure)) {
+        return result;
+    }
+    if (options.method == Method::ConjugateGradient) {
+        conjugateGradient(a, options, m, b, bNorm, result, report);
+    } else if (options.method == Method::Gmres) {
+        gmres(a, options, m, b, bNorm, result, report);
+    } else {
+        stationary(a, options, b, bNorm, result, report);
+    }
+
+    // Recurrences drift, so judge the answer by its true residual
+    result.residual = relativeResidual(a, b, result.x, bNorm);
+    result.converged = result.failure.empty() && result.residual <= options.tolerance;
+    scope.setWork(2 * a.nonZeros() * result.iterations, a.nonZeros() * sizeof(float) * result.iterations);
+    return result;
+}
+
+} // namespace iterative
+
+// Solve an augmented system iteratively and return x as an n x 1 matrix
+// called name, reporting the residual after each iteration when tracing.
+// Returns an empty matrix if the method could not run; converged says
+// whether the tolerance was met.
+Matrix solveIteratively(const iterative::System& system, const iterative::Options& options,
+                        const std::string& name, bool& converged) {
+    iterative::Result result = iterative::solve(system, options, [](size_t iteration, double residual) {
+        if (Matrix::getVerbosity() >= Verbosity::Steps) {
+            std::cout << "Iteration " << iteration << ": relative residual " << residual << "\n";
+        }
+    });
+    converged = result.converged;
+    if (!result.failure.empty() && result.iterations == 0) {
+        std::cerr << "Error: " << result.failure << "\n";
+        return Matrix();
+    }
+    if (!result.failure.empty()) {
+        std::cerr << "Error: " << result.failure << "\n";
+    }
+    std::cout << (result.converged ? "Converged" : "Did not converge") << " after " << result.iterations
+              << " iterations, relative residual " << result.residual << ".\n";
+    Matrix x(name, system.size(), 1);
+    for (size_t i = 0; i < system.size(); ++i) {
+        x.setElement(i, 0, static_cast<float>(result.x[i]));
+    }
+    return x;
+}
+
+// Matrix expressions
+//
+// "DEST = EXPR" where EXPR combines matrix names and numbers with + - *,
+// parentheses, transpose(X) and the postfix X'. The statement is parsed into a
+// tree and shape-checked before anything is computed, then evaluated once:
+//
+// - A sum is flattened into scaled terms. Product terms are written by the
+//   GEMM kernel straight into the result, and every other term is folded in
+//   by one fused pass over the rows instead of a temporary per operator.
+// - Names and transposed names are read through views, never copied. Only a
+//   compound operand of a product (or of a transpose) is materialized.
+// - Scalar factors are folded into the term coefficients, or into an operand
+//   that has to be materialized anyway.
+// - DEST's own storage is reused when it already has the right shape and the
+//   expression cannot read an element after it has been overwritten.
+namespace expr {
+
+struct Node {
+    enum class Kind { Leaf, Number, Transpose, Add, Subtract, Multiply, Negate };
+    explicit Node(Kind kind) : kind(kind) {}
+
+    Kind kind;
+    const Matrix* matrix = nullptr; // Leaf
+    float value = 0.0f;             // Number
+    std::unique_ptr<Node> left, right;
+    bool scalar = false;
+    size_t rows = 0, columns = 0;
+};
+
+using NodePtr = std::unique_ptr<Node>;
+
+class Parser {
+public:
+    Parser(const std::string& text, const std::map<std::string, Matrix>& matrices)
+        : pos(text.data()), end(text.data() + text.size()), matrices(matrices) {}
+
+    // Returns null and sets error if the text is not a single well-formed expression
+    NodePtr parse(std::string& errorOut) {
+        NodePtr root = parseSum();
+        skipSpace();
+        if (root && pos != end) {
+            fail(std::string("Unexpected '") + *pos + "'.");
+        }
+        if (!error.empty()) {
+            errorOut = error;
+            return nullptr;
+        }
+        return root;
+    }
+
+private:
+    const char* pos;
+    const char* end;
+    const std::map<std::string, Matrix>& matrices;
+    std::string error;
+
+    void fail(const std::string& message) {
+        if (error.empty()) {
+            error = message;
+        }
+    }
+
+    void skipSpace() {
+        while (pos != end && std::isspace(static_cast<unsigned char>(*pos))) {
+            ++pos;
+        }
+    }
+
+    bool accept(char c) {
+        skipSpace();
+        if (pos != end && *pos == c) {
+            ++pos;
+            return true;
+        }
+        return false;
+    }
+
+    NodePtr makeBinary(Node::Kind kind, NodePtr left, NodePtr right) {
+        if (!left || !right) {
+            return nullptr;
+        }
+        NodePtr node = std::make_unique<Node>(kind);
+        node->scalar = left->scalar && right->scalar;
+        if (kind == Node::Kind::Multiply) {
+            if (left->scalar || right->scalar) {
+                const Node& shape = left->scalar ? *right : *left;
+                node->rows = shape.rows;
+                node->columns = shape.columns;
+            } else if (left->columns != right->rows) {
+                fail("Cannot multiply a " + std::to_string(left->rows) + "x" + std::to_string(left->columns) +
+                     " matrix by a " + std::to_string(right->rows) + "x" + std::to_string(right->columns) + " matrix.");
+                return nullptr;
+            } else {
+                node->rows = left->rows;
+                node->columns = right->columns;
+            }
+        } else {
+            if (left->scalar != right->scalar || left->rows != right->rows || left->columns != right->columns) {
+                fail("Matrices must have the same dimensions to be added.");
+                return nullptr;
+            }
+            node->rows = left->rows;
+            node->columns = left->columns;
+        }
+        node->left = std::move(left);
+        node->right = std::move(right);
+        return node;
+    }
+
+    NodePtr makeTranspose(NodePtr child) {
+        if (!child) {
+            return nullptr;
+        }
+        NodePtr node = std::make_unique<Node>(Node::Kind::Transpose);
+        node->scalar = child->scalar;
+        node->rows = child->columns;
+        node->columns = child->rows;
+        node->left = std::move(child);
+        return node;
+    }
+
+    NodePtr parseSum() {
+        NodePtr node = parseProduct();
+        while (node) {
+            if (accept('+')) {
+                node = makeBinary(Node::Kind::Add, std::move(node), parseProduct());
+            } else if (accept('-')) {
+                node = makeBinary(Node::Kind::Subtract, std::move(node), parseProduct());
+            } else {
+                break;
+            }
+        }
+        return node;
+    }
+
+    NodePtr parseProduct() {
+        NodePtr node = parseUnary();
+        while (node && accept('*')) {
+            node = makeBinary(Node::Kind::Multiply, std::move(node), parseUnary());
+        }
+        return node;
+    }
+
+    NodePtr parseUnary() {
+        if (accept('-')) {
+            NodePtr child = parseUnary();
+            if (!child) {
+                return nullptr;
+            }
+            NodePtr node = std::make_unique<Node>(Node::Kind::Negate);
+            node->scalar = child->scalar;
+            node->rows = child->rows;
+            node->columns = child->columns;
+            node->left = std::move(child);
+            return node;
+        }
+        NodePtr node = parsePrimary();
+        while (node && accept('\'')) {
+            node = makeTranspose(std::move(node));
+        }
+        return node;
+    }
+
+    NodePtr parsePrimary() {
+        skipSpace();
+        if (pos == end) {
+            fail("Unexpected end of expression.");
+            return nullptr;
+        }
+        if (accept('(')) {
+            NodePtr node = parseSum();
+            if (node && !accept(')')) {
+                fail("Expected ')'.");
+                return nullptr;
+            }
+            return node;
+        }
+        if (std::isdigit(static_cast<unsigned char>(*pos)) || *pos == '.') {
+            NodePtr node = std::make_unique<Node>(Node::Kind::Number);
+            node->scalar = true;
+            auto result = std::from_chars(pos, end, node->value);
+            if (result.ec != std::errc()) {
+                fail("Invalid number.");
+                return nullptr;
+            }
+            pos = result.ptr;
+            return node;
+        }
+        const char* start = pos;
+        while (pos != end && (std::isalnum(static_cast<unsigned char>(*pos)) || *pos == '_')) {
+            ++pos;
+        }
+        if (start == pos) {
+            fail(std::string("Unexpected '") + *pos + "'.");
+            return nullptr;
+        }
+        std::string name(start, pos);
+        if (name == "transpose" && accept('(')) {
+            NodePtr child = parseSum();
+            if (child && !accept(')')) {
+                fail("Expected ')'.");
+                return nullptr;
+            }
+            return makeTranspose(std::move(child));
+        }
+        auto it = matrices.find(name);
+        if (it == matrices.end()) {
+            fail("Matrix with name " + name + " does not exist.");
+            return nullptr;
+        }
+        NodePtr node = std::make_unique<Node>(Node::Kind::Leaf);
+        node->matrix = &it->second;
+        node->rows = it->second.view().rows;
+        node->columns = it->second.view().columns;
+        return node;
+    }
+};
+
+float scalarValue(const Node& n) {
+    switch (n.kind) {
+        case Node::Kind::Number: return n.value;
+        case Node::Kind::Transpose: return scalarValue(*n.left);
+        case Node::Kind::Negate: return -scalarValue(*n.left);
+        case Node::Kind::Add: return scalarValue(*n.left) + scalarValue(*n.right);
+        case Node::Kind::Subtract: return scalarValue(*n.left) - scalarValue(*n.right);
+        case Node::Kind::Multiply: return scalarValue(*n.left) * scalarValue(*n.right);
+        default: return 0.0f;
+    }
+}
+
+// A matrix-valued summand: coefficient * (leaf, transposed leaf, product or
+// transpose of a compound expression)
+struct Term {
+    float coefficient;
+    const Node* node;
+};
+
+void collectTerms(const Node& n, float coefficient, std::vector<Term>& terms) {
+    switch (n.kind) {
+        case Node::Kind::Add:
+            collectTerms(*n.left, coefficient, terms);
+            collectTerms(*n.right, coefficient, terms);
+            return;
+        case Node::Kind::Subtract:
+            collectTerms(*n.left, coefficient, terms);
+            collectTerms(*n.right, -coefficient, terms);
+            return;
+        case Node::Kind::Negate:
+            collectTerms(*n.left, -coefficient, terms);
+            return;
+        case Node::Kind::Multiply:
+            if (n.left->scalar) {
+                collectTerms(*n.right, coefficient * scalarValue(*n.left), terms);
+                return;
+            }
+            if (n.right->scalar) {
+                collectTerms(*n.left, coefficient * scalarValue(*n.right), terms);
+                return;
+            }
+            break;
+        case Node::Kind::Transpose:
+            if (n.left->kind == Node::Kind::Transpose) {
+                collectTerms(*n.left->left, coefficient, terms);
+                return;
+            }
+            break;
+        default:
+            break;
+    }
+    terms.push_back({coefficient, &n});
+}
+
+bool isProduct(const Node& n) {
+    return n.kind == Node::Kind::Multiply;
+}
+
+class Evaluator {
+public:
+    // out = coefficient * n. out may alias a name n reads only if n has no
+    // products or transposes.
+    void evaluateInto(const Node& n, float coefficient, FloatView out) {
+        std::vector<Term> terms;
+        collectTerms(n, coefficient, terms);
+
+        // Resolve every operand before the first write to out
+        struct ProductStep {
+            ConstFloatView a, b;
+        };
+        std::vector<ProductStep> products;
+        std::vector<std::pair<float, ConstFloatView>> elementwise;
+        for (const Term& t : terms) {
+            if (isProduct(*t.node)) {
+                // Fold the coefficient into whichever operand is materialized anyway
+                bool scaleRight = t.coefficient != 1.0f && isView(*t.node->left) && !isView(*t.node->right);
+                ConstFloatView a = operand(*t.node->left, scaleRight ? 1.0f : t.coefficient);
+                ConstFloatView b = operand(*t.node->right, scaleRight ? t.coefficient : 1.0f);
+                products.push_back({a, b});
+            } else {
+                elementwise.push_back({t.coefficient, operand(*t.node, 1.0f)});
+            }
+        }
+
+        bool initialized = false;
+        for (const ProductStep& p : products) {
+            if (initialized) {
+                multiplyAddInto(p.a, p.b, out);
+            } else {
+                multiplyInto(p.a, p.b, out);
+                initialized = true;
+            }
+        }
+        if (elementwise.empty()) {
+            return;
+        }
+        // Each element is read from every term before it is written, so one
+        // of the terms may be out itself
+        parallelRange(out.rows, out.columns * elementwise.size(), [&](size_t begin, size_t end) {
+            for (size_t r = begin; r < end; ++r) {
+                float* o = &out(r, 0);
+                for (size_t j = 0; j < out.columns; ++j) {
+                    float sum = initialized ? o[j] : 0.0f;
+                    for (const auto& term : elementwise) {
+                        sum += term.first * term.second(r, j);
+                    }
+                    o[j] = sum;
+                }
+            }
+        });
+    }
+
+private:
+    std::deque<Matrix> temporaries;
+
+    static bool isView(const Node& n) {
+        return n.kind == Node::Kind::Leaf ||
+               (n.kind == Node::Kind::Transpose && n.left->kind == Node::Kind::Leaf);
+    }
+
+    // A view of coefficient * n, materializing n only when it is not a
+    // (transposed) name
+    ConstFloatView operand(const Node& n, float coefficient) {
+        if (coefficient == 1.0f && n.kind == Node::Kind::Leaf) {
+            return n.matrix->view();
+        }
+        if (coefficient == 1.0f && n.kind == Node::Kind::Transpose) {
+            if (n.left->kind == Node::Kind::Leaf) {
+                return n.left->matrix->transposedView();
+            }
+            if (n.left->kind != Node::Kind::Transpose) {
+                return materialize(*n.left, 1.0f).transposed();
+            }
+        }
+        return materialize(n, coefficient);
+    }
+
+    ConstFloatView materialize(const Node& n, float coefficient) {
+        temporaries.emplace_back("", n.rows, n.columns);
+        FloatView v = temporaries.back().view();
+        evaluateInto(n, coefficient, v);
+        return v;
+    }
+};
+
+bool readsMatrix(const Node& n, const Matrix* m) {
+    return (n.kind == Node::Kind::Leaf && n.matrix == m) ||
+           (n.left && readsMatrix(*n.left, m)) || (n.right && readsMatrix(*n.right, m));
+}
+
+bool hasProductOrTranspose(const Node& n) {
+    if (n.kind == Node::Kind::Transpose || (n.kind == Node::Kind::Multiply && !n.left->scalar && !n.right->scalar)) {
+        return true;
+    }
+    return (n.left && hasProductOrTranspose(*n.left)) || (n.right && hasProductOrTranspose(*n.right));
+}
+
+// Nominal work for the stats counters: each operator's flops, each leaf read once
+void nominalWork(const Node& n, uint64_t& flops, uint64_t& bytes) {
+    if (n.kind == Node::Kind::Leaf) {
+        bytes += n.rows * n.columns * sizeof(float);
+        return;
+    }
+    if (n.left) {
+        nominalWork(*n.left, flops, bytes);
+    }
+    if (n.right) {
+        nominalWork(*n.right, flops, bytes);
+    }
+    if (n.kind == Node::Kind::Multiply && !n.left->scalar && !n.right->scalar) {
+        flops += 2 * n.rows * n.columns * n.left->columns;
+    } else if (n.kind != Node::Kind::Transpose && n.kind != Node::Kind::Number) {
+        flops += n.rows * n.columns;
+    }
+}
+
+// Evaluate "DEST = EXPR" into matrices[DEST]. On failure nothing is modified
+// and error says why.
+bool assign(const std::string& statement, std::map<std::string, Matrix>& matrices, std::string& dest, std::string& error) {
+    size_t equals = statement.find('=');
+    if (equals == std::string::npos) {
+        error = "Expected DEST = EXPRESSION.";
+        return false;
+    }
+    size_t first = statement.find_first_not_of(" \t", 0);
+    size_t last = statement.find_last_not_of(" \t", equals - 1);
+    if (equals == 0 || first >= equals || last == std::string::npos || last < first) {
+        error = "Expected DEST = EXPRESSION.";
+        return false;
+    }
+    dest = statement.substr(first, last - first + 1);
+    // DEST must be a single name an expression could refer to
+    for (char c : dest) {
+        if (!std::isalnum(static_cast<unsigned char>(c)) && c != '_') {
+            error = "Invalid destination " + dest + "; names use letters, digits and '_'.";
+            return false;
+        }
+    }
+
+    stats::Scope scope(stats::Op::Eval);
+    NodePtr root = Parser(statement.substr(equals + 1), matrices).parse(error);
+    if (!root) {
+        return false;
+    }
+    if (root->scalar) {
+        error = "The expression must produce a matrix.";
+        return false;
+    }
+
+    if (scope.isActive()) {
+        uint64_t flops = 0, bytes = root->rows * root->columns * sizeof(float);
+        nominalWork(*root, flops, bytes);
+        scope.setWork(flops, bytes);
+    }
+
+    // Overwrite DEST in place only if every element is read before it is written
+    auto it = matrices.find(dest);
+    bool inPlace = it != matrices.end() && it->second.rowCount() == root->rows &&
+                   it->second.columnCount() == root->columns &&
+                   (!readsMatrix(*root, &it->second) || !hasProductOrTranspose(*root));
+    Evaluator evaluator;
+    if (inPlace) {
+        evaluator.evaluateInto(*root, 1.0f, it->second.view());
+    } else {
+        Matrix result(dest, root->rows, root->columns);
+        evaluator.evaluateInto(*root, 1.0f, result.view());
+        matrices[dest] = std::move(result);
+    }
+    return true;
+}
+
+} // namespace expr
+
+// Reduce m to RREF in exact rational arithmetic, print the exact result and
+// store its float approximation back in m
+void solveExactly(Matrix& m) {
+    stats::Scope scope(stats::Op::ExactSolve, 0, 2 * m.rowCount() * m.columnCount() * sizeof(float));
+    BasicMatrix<Rational> exact = BasicMatrix<Rational>::fromMatrix(m);
+    reportSolutionKind(m.getName(), reduceToRrefExact(exact.view()));
+    exact.print();
+    m = exact.toMatrix();
+}
+
+// What the menu's or a script's named matrices hold
+stats::Holdings holdingsOf(const std::map<std::string, Matrix>& matrices,
+                           const std::map<std::string, SparseMatrix>& sparseMatrices) {
+    stats::Holdings held;
+    for (const auto& pair : matrices) {
+        ++held.denseCount;
+        held.denseBytes += pair.second.memoryBytes();
+    }
+    for (const auto& pair : sparseMatrices) {
+        ++held.sparseCount;
+        held.sparseBytes += pair.second.memoryBytes();
+    }
+    return held;
+}
+
+// The stats command: no action prints the report, "on" and "off" switch
+// timing, "reset" clears the counters and "json" writes them to path, or to
+// stdout when path is empty. Returns false and sets error on bad input.
+bool runStatsCommand(const std::string& action, const std::string& path,
+                     const std::map<std::string, Matrix>& matrices,
+                     const std::map<std::string, SparseMatrix>& sparseMatrices, std::string& error) {
+    if (!path.empty() && action != "json") {
+        error = "Only stats json takes a file.";
+        return false;
+    }
+    if (action.empty()) {
+        stats::report(std::cout, holdingsOf(matrices, sparseMatrices));
+    } else if (action == "on" || action == "off") {
+        stats::setEnabled(action == "on");
+    } else if (action == "reset") {
+        stats::reset();
+    } else if (action == "json") {
+        if (path.empty()) {
+            stats::writeJson(std::cout, holdingsOf(matrices, sparseMatrices));
+            return true;
+        }
+        std::ofstream file(path);
+        stats::writeJson(file, holdingsOf(matrices, sparseMatrices));
+        if (!file) {
+            error = "Could not write " + path + ".";
+            return false;
+        }
+    } else {
+        error = "Unknown stats action " + action + "; expected on, off, reset or json.";
+        return false;
+    }
+    return true;
+}
+
+// The tiled command, on .mtxt files rather than named matrices:
+//
+//   save NAME FILE [TILE]   write the named matrix as TILE x TILE tiles
+//   load NAME FILE          read a tiled file that fits in memory
+//   add|multiply OUT A B    OUT = A + B or A * B
+//   transpose OUT A
+//   solve OUT A B           OUT = A^-1 * B by out-of-core LU
+//   memory MIB              set the budget the operations stay within
+//
+// Returns false and sets error on bad input or a failed operation, whose
+// details have been printed already.
+bool runTiledCommand(const std::vector<std::string>& args, std::map<std::string, Matrix>& matrices,
+                     std::map<std::string, SparseMatrix>& sparseMatrices, std::string& error) {
+    const std::string action = args.empty() ? "" : args[0];
+    auto parsePositive = [](const std::string& text, size_t& value) {
+        char* end = nullptr;
+        long parsed = std::strtol(text.c_str(), &end, 10);
+        value = parsed > 0 ? static_cast<size_t>(parsed) : 0;
+        return end != text.c_str() && *end == '\0' && parsed > 0;
+    };
+
+    if (action == "save") {
+        size_t tileSize = kDefaultTileSize;
+        if (args.size() < 3 || args.size() > 4) {
+            error = "Usage: tiled save NAME FILE [TILE]";
+            return false;
+        }
+        if (args.size() == 4 && !parsePositive(args[3], tileSize)) {
+            error = "The tile size must be a positive number.";
+            return false;
+        }
+        auto it = matrices.find(args[1]);
+        if (it == matrices.end()) {
+            error = "Matrix with name " + args[1] + " does not exist.";
+            return false;
+        }
+        if (TiledMatrix::fromMatrix(std::as_const(it->second).view(), args[2], tileSize).isEmpty()) {
+            error = "Could not save " + args[1] + ".";
+            return false;
+        }
+    } else if (action == "load") {
+        if (args.size() != 3) {
+            error = "Usage: tiled load NAME FILE";
+            return false;
+        }
+        TiledMatrix tiled = TiledMatrix::open(args[2]);
+        Matrix m = tiled.toMatrix(args[1]);
+        if (tiled.isEmpty() || (m.isEmpty() && tiled.rowCount() > 0 && tiled.columnCount() > 0)) {
+            error = "Could not load " + args[2] + ".";
+            return false;
+        }
+        sparseMatrices.erase(args[1]);
+        matrices[args[1]] = std::move(m);
+    } else if (action == "add" || action == "multiply" || action == "solve") {
+        if (args.size() != 4) {
+            error = "Usage: tiled " + action + " OUT A B";
+            return false;
+        }
+        TiledMatrix a = TiledMatrix::open(args[2]);
+        TiledMatrix b = a.isEmpty() ? TiledMatrix() : TiledMatrix::open(args[3]);
+        if (b.isEmpty()) {
+            error = "Could not open the operands.";
+            return false;
+        }
+        if (a.isStoredIn(args[1]) || b.isStoredIn(args[1])) {
+            error = "The result " + args[1] + " would overwrite an operand.";
+            return false;
+        }
+        TiledMatrix result = action == "add" ? a.add(b, args[1]) : action == "multiply" ? a.multiply(b, args[1])
+                                                                                       : a.solve(b, args[1]);
+        if (result.isEmpty()) {
+            error = "Could not compute " + args[1] + ".";
+            return false;
+        }
+    } else if (action == "transpose") {
+        if (args.size() != 3) {
+            error = "Usage: tiled transpose OUT A";
+            return false;
+        }
+        TiledMatrix a = TiledMatrix::open(args[2]);
+        if (a.isStoredIn(args[1])) {
+            error = "The result " + args[1] + " would overwrite an operand.";
+            return false;
+        }
+        if (a.isEmpty() || a.transpose(args[1]).isEmpty()) {
+            error = "Could not compute " + args[1] + ".";
+            return false;
+        }
+    } else if (action == "memory") {
+        size_t mebibytes;
+        if (args.size() != 2 || !parsePositive(args[1], mebibytes)) {
+            error = "Usage: tiled memory MIB";
+            return false;
+        }
+        TiledMatrix::setMemoryBudget(mebibytes);
+    } else {
+        error = "Unknown tiled action " + action + "; expected save, load, add, multiply, transpose, solve or memory.";
+        return false;
+    }
+    return true;
+}
+
+// Batch mode
+//
+// Reads one command per line from a file or stdin. Blank lines and anything
+// after '#' are ignored, names are single words and row numbers are 1-based:
+//
+//   define NAME ROWS COLS        create a zero matrix
+//   load NAME                    the next ROWS lines hold COLS values each
+//   load NAME FILE [verify]      map a .mtxb file, optionally checking its checksum
+//   save NAME FILE               write NAME as a .mtxb file
+//   import NAME FILE             read a CSV, whitespace or Matrix Market text file
+//   print NAME|ALL [full]        also spelled "output"; without "full", matrices over
+//                                kPrintSummaryThreshold elements show only their corners
+//   export NAME FILE [csv|raw]   CSV with exact values (the default), or headerless
+//                                row-major float32
+//   scale NAME ROW MULT          multiply a row
+//   addrows NAME ROW1 ROW2 MULT  add MULT times ROW2 to ROW1
+//   swap NAME ROW1 ROW2
+//   undo NAME [COUNT]            undo the last scale, addrows or swap steps
+//   redo NAME [COUNT]
+//   replay DEST SRC              apply SRC's scale, addrows and swap steps to DEST
+//   solve NAME
+//   fastsolve NAME [double]      blocked RREF, reports unique/infinite/inconsistent;
+//                                "double" reduces in double precision
+//   itersolve DEST NAME METHOD [PRECOND] [TOL] [MAXITER]
+//                                solve the augmented system NAME iteratively into the
+//                                column DEST; METHOD is cg, gmres, jacobi or gaussseidel,
+//                                PRECOND none, jacobi or ilu0 (default none, 1e-6, 1000)
+//   transpose NAME [DEST]
+//   add DEST A B                 DEST = A + B
+//   multiply DEST A B            DEST = A * B
+//   duplicate SRC DEST
+//   factor NAME                  LU factorize and report rank and determinant
+//   lusolve DEST A B             DEST = A^-1 * B, reusing A's cached factors
+//   inverse DEST A
+//   verbosity 0|1|2              silent, steps or full trace
+//   sparsify NAME                convert NAME to a sparse (CSR) matrix
+//   densify NAME                 convert NAME back to a dense matrix
+//   importsparse NAME FILE       read a Matrix Market file as a sparse matrix
+//   eval DEST = EXPR             e.g. eval C = A*B + 2*D or eval A = A' * A
+//   exactsolve NAME              RREF in exact rational arithmetic, printed as fractions
+//   stats [on|off|reset]         show operation timings and memory, or control them
+//   stats json [FILE]            write the same figures as JSON
+//   tiled ACTION ...             out-of-core work on tiled .mtxt files; see runTiledCommand
+//
+// Values accept the same a/b fraction syntax as the menu. Dense and sparse
+// matrices share one set of names. print, fastsolve, transpose, duplicate,
+// add and multiply accept either kind; add and multiply give a sparse result
+// only when both operands are sparse.
+class ScriptRunner {
+public:
+    ScriptRunner(std::istream& in, std::map<std::string, Matrix>& matrices,
+                 std::map<std::string, SparseMatrix>& sparseMatrices)
+        : in(in), matrices(matrices), sparseMatrices(sparseMatrices) {}
+
+    // Returns the number of commands that failed
+    size_t run() {
+        std::string line;
+        while (nextLine(line)) {
+            std::istringstream iss(line);
+            std::vector<std::string> args;
+            std::string token;
+            while (iss >> token) {
+                args.push_back(token);
+            }
+            execute(args);
+        }
+        return errors;
+    }
+
+private:
+    std::istream& in;
+    std::map<std::string, Matrix>& matrices;
+    std::map<std::string, SparseMatrix>& sparseMatrices;
+    size_t lineNumber = 0;
+    size_t errors = 0;
+
+    // Fetch the next line that has something on it once comments are stripped
+    bool nextLine(std::string& line) {
+        while (std::getline(in, line)) {
+            ++lineNumber;
+            size_t hash = line.find('#');
+            if (hash != std::string::npos) {
+                line.erase(hash);
+            }
+            if (line.find_first_not_of(" \t\r") != std::string::npos) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void fail(const std::string& message) {
+        std::cerr << "Error: line " << lineNumber << ": " << message << "\n";
+        ++errors;
+    }
+
+    static bool parseIndex(const std::string& token, size_t& value) {
+        char* end = nullptr;
+        unsigned long long parsed = std::strtoull(token.c_str(), &end, 10);
+        if (end == token.c_str() || *end != '\0' || token[0] == '-') {
+            return false;
+        }
+        value = static_cast<size_t>(parsed);
+        return true;
+    }
+
+    static bool parseNumber(const std::string& token, float& value) {
+        return ::parseNumber(token.data(), token.data() + token.size(), value);
+    }
+
+    Matrix* find(const std::string& name) {
+        auto it = matrices.find(name);
+        if (it == matrices.end()) {
+            fail(sparseMatrices.count(name) ? "Matrix " + name + " is sparse; densify it first."
+                                            : "Matrix with name " + name + " does not exist.");
+            return nullptr;
+        }
+        return &it->second;
+    }
+
+    // Storing under a name replaces a matrix of the other kind with that name
+    void store(const std::string& name, Matrix m) {
+        sparseMatrices.erase(name);
+        matrices[name] = std::move(m);
+    }
+
+    void store(const std::string& name, SparseMatrix m) {
+        matrices.erase(name);
+        sparseMatrices[name] = std::move(m);
+    }
+
+    bool expectArgs(const std::vector<std::string>& args, size_t minCount, size_t maxCount, const char* usage) {
+        if (args.size() < minCount || args.size() > maxCount) {
+            fail(std::string("Usage: ") + usage);
+            return false;
+        }
+        return true;
+    }
+
+    void execute(const std::vector<std::string>& args) {
+        const std::string& command = args[0];
+        if (command == "define") {
+            size_t rows, cols;
+            if (!expectArgs(args, 4, 4, "define NAME ROWS COLS")) {
+                return;
+            }
+            if (!parseIndex(args[2], rows) || !parseIndex(args[3], cols)) {
+                fail("Invalid dimensions.");
+                return;
+            }
+            store(args[1], Matrix(args[1], rows, cols));
+        } else if (command == "load") {
+            if (!expectArgs(args, 2, 4, "load NAME [FILE [verify]]")) {
+                return;
+            }
+            if (args.size() == 2) {
+                if (Matrix* m = find(args[1])) {
+                    loadRows(*m);
+                }
+                return;
+            }
+            if (args.size() == 4 && args[3] != "verify") {
+                fail("Usage: load NAME [FILE [verify]]");
+                return;
+            }
+            Matrix loaded = Matrix::load(args[2], args[1], args.size() == 4);
+            if (loaded.isEmpty()) {
+                fail("Could not load " + args[2] + ".");
+                return;
+            }
+            store(args[1], std::move(loaded));
+        } else if (command == "import") {
+            if (!expectArgs(args, 3, 3, "import NAME FILE")) {
+                return;
+            }
+            Matrix imported = importTextMatrix(args[2], args[1]);
+            if (imported.isEmpty()) {
+                fail("Could not import " + args[2] + ".");
+                return;
+            }
+            store(args[1], std::move(imported));
+        } else if (command == "save") {
+            if (!expectArgs(args, 3, 3, "save NAME FILE")) {
+                return;
+            }
+            Matrix* m = find(args[1]);
+            if (m && !m->save(args[2])) {
+                fail("Could not save " + args[1] + ".");
+            }
+        } else if (command == "print" || command == "output") {
+            if (!expectArgs(args, 2, 3, "print NAME|ALL [full]")) {
+                return;
+            }
+            if (args.size() == 3 && args[2] != "full") {
+                fail("Usage: print NAME|ALL [full]");
+                return;
+            }
+            const bool full = args.size() == 3;
+            if (args[1] == "ALL") {
+                for (const auto& pair : matrices) {
+                    pair.second.print(full);
+                }
+                for (const auto& pair : sparseMatrices) {
+                    pair.second.print(full);
+                }
+            } else if (sparseMatrices.count(args[1])) {
+                sparseMatrices[args[1]].print(full);
+            } else if (Matrix* m = find(args[1])) {
+                m->print(full);
+            }
+        } else if (command == "export") {
+            if (!expectArgs(args, 3, 4, "export NAME FILE [csv|raw]")) {
+                return;
+            }
+            const std::string format = args.size() == 4 ? args[3] : "csv";
+            if (format != "csv" && format != "raw") {
+                fail("Usage: export NAME FILE [csv|raw]");
+                return;
+            }
+            Matrix* m = find(args[1]);
+            if (m && !(format == "csv" ? m->exportCsv(args[2]) : m->exportRaw(args[2]))) {
+                fail("Could not export " + args[1] + ".");
+            }
+        } else if (command == "scale") {
+            size_t row;
+            float multiplier;
+            if (!expectArgs(args, 4, 4, "scale NAME ROW MULT")) {
+                return;
+            }
+            if (!parseIndex(args[2], row) || row == 0 || !parseNumber(args[3], multiplier)) {
+                fail("Invalid row or multiplier.");
+                return;
+            }
+            if (Matrix* m = find(args[1])) {
+                m->multiplyRow(multiplier, row - 1);
+            }
+        } else if (command == "addrows") {
+            size_t row1, row2;
+            float multiplier;
+            if (!expectArgs(args, 5, 5, "addrows NAME ROW1 ROW2 MULT")) {
+                return;
+            }
+            if (!parseIndex(args[2], row1) || !parseIndex(args[3], row2) || row1 == 0 || row2 == 0 ||
+                !parseNumber(args[4], multiplier)) {
+                fail("Invalid rows or multiplier.");
+                return;
+            }
+            if (Matrix* m = find(args[1])) {
+                m->addRows(multiplier, row1 - 1, row2 - 1);
+            }
+        } else if (command == "swap") {
+            size_t row1, row2;
+            if (!expectArgs(args, 4, 4, "swap NAME ROW1 ROW2")) {
+                return;
+            }
+            if (!parseIndex(args[2], row1) || !parseIndex(args[3], row2) || row1 == 0 || row2 == 0) {
+                fail("Invalid rows.");
+                return;
+            }
+            if (Matrix* m = find(args[1])) {
+                m->swapRows(row1 - 1, row2 - 1);
+            }
+        } else if (command == "undo" || command == "redo") {
+            size_t count = 1;
+            if (!expectArgs(args, 2, 3, command == "undo" ? "undo NAME [COUNT]" : "redo NAME [COUNT]")) {
+                return;
+            }
+            if (args.size() == 3 && !parseIndex(args[2], count)) {
+                fail("Invalid count.");
+                return;
+            }
+            if (Matrix* m = find(args[1])) {
+                for (size_t i = 0; i < count; ++i) {
+                    if (!(command == "undo" ? m->undo() : m->redo())) {
+                        fail("Nothing to " + command + " for matrix " + args[1] + ".");
+                        return;
+                    }
+                }
+            }
+        } else if (command == "replay") {
+            if (!expectArgs(args, 3, 3, "replay DEST SRC")) {
+                return;
+            }
+            Matrix* dest = find(args[1]);
+            Matrix* src = dest ? find(args[2]) : nullptr;
+            if (src && !dest->replay(src->journal())) {
+                fail("Could not replay the row operations of " + args[2] + " on " + args[1] + ".");
+            }
+        } else if (command == "solve") {
+            if (!expectArgs(args, 2, 2, "solve NAME")) {
+                return;
+            }
+            if (Matrix* m = find(args[1])) {
+                m->attemptSolution();
+            }
+        } else if (command == "fastsolve") {
+            if (!expectArgs(args, 2, 3, "fastsolve NAME [double]")) {
+                return;
+            }
+            if (args.size() == 3) {
+                if (args[2] != "double") {
+                    fail("Usage: fastsolve NAME [double]");
+                } else if (Matrix* m = find(args[1])) {
+                    BasicMatrix<double> wide = BasicMatrix<double>::fromMatrix(*m);
+                    reportSolutionKind(m->getName(), wide.fastSolve());
+                    *m = wide.toMatrix();
+                }
+                return;
+            }
+            if (sparseMatrices.count(args[1])) {
+                reportSolutionKind(args[1], sparseMatrices[args[1]].solve());
+            } else if (Matrix* m = find(args[1])) {
+                reportSolutionKind(m->getName(), m->fastSolve());
+            }
+        } else if (command == "itersolve") {
+            if (!expectArgs(args, 4, 7, "itersolve DEST NAME cg|gmres|jacobi|gaussseidel [none|jacobi|ilu0] [TOL] [MAXITER]")) {
+                return;
+            }
+            iterative::Options options;
+            float tolerance = static_cast<float>(options.tolerance);
+            if (!iterative::parseMethod(args[3], options.method) ||
+                (args.size() > 4 && !iterative::parsePreconditioner(args[4], options.preconditioner)) ||
+                (args.size() > 5 && (!parseNumber(args[5], tolerance) || !(tolerance > 0.0f))) ||
+                (args.size() > 6 && (!parseIndex(args[6], options.maxIterations) || options.maxIterations == 0))) {
+                fail("Invalid method, preconditioner, tolerance or iteration limit.");
+                return;
+            }
+            options.tolerance = tolerance;
+            bool converged = false;
+            Matrix x;
+            auto sparse = sparseMatrices.find(args[2]);
+            if (sparse != sparseMatrices.end()) {
+                x = solveIteratively(iterative::System(sparse->second), options, args[1], converged);
+            } else if (const Matrix* m = find(args[2])) {
+                x = solveIteratively(iterative::System(m->view()), options, args[1], converged);
+            } else {
+                return;
+            }
+            if (!x.isEmpty()) {
+                store(args[1], std::move(x));
+            }
+            if (!converged) {
+                fail("Iterative solve of " + args[2] + " did not converge.");
+            }
+        } else if (command == "transpose") {
+            if (!expectArgs(args, 2, 3, "transpose NAME [DEST]")) {
+                return;
+            }
+            const std::string& dest = args.size() == 3 ? args[2] : args[1];
+            if (sparseMatrices.count(args[1])) {
+                SparseMatrix transposed = sparseMatrices[args[1]].transpose();
+                transposed.setName(dest);
+                store(dest, std::move(transposed));
+            } else if (Matrix* m = find(args[1])) {
+                if (dest == args[1]) {
+                    m->transposeInPlace();
+                    return;
+                }
+                Matrix transposed = m->transpose();
+                transposed.setName(dest);
+                store(dest, std::move(transposed));
+            }
+        } else if (command == "add" || command == "multiply") {
+            if (!expectArgs(args, 4, 4, command == "add" ? "add DEST A B" : "multiply DEST A B")) {
+                return;
+            }
+            if (sparseMatrices.count(args[2]) || sparseMatrices.count(args[3])) {
+                combineSparse(command == "add", args[1], args[2], args[3]);
+                return;
+            }
+            Matrix* a = find(args[2]);
+            Matrix* b = a ? find(args[3]) : nullptr;
+            if (!a || !b) {
+                return;
+            }
+            Matrix result = command == "add" ? a->add(*b) : a->multiply(*b);
+            if (result.isEmpty()) {
+                fail("Dimension mismatch.");
+                return;
+            }
+            result.setName(args[1]);
+            store(args[1], std::move(result));
+        } else if (command == "duplicate") {
+            if (!expectArgs(args, 3, 3, "duplicate SRC DEST")) {
+                return;
+            }
+            if (sparseMatrices.count(args[1])) {
+                SparseMatrix copy = sparseMatrices[args[1]];
+                copy.setName(args[2]);
+                store(args[2], std::move(copy));
+            } else if (Matrix* m = find(args[1])) {
+                store(args[2], m->duplicate(args[2]));
+            }
+        } else if (command == "factor") {
+            if (!expectArgs(args, 2, 2, "factor NAME")) {
+                return;
+            }
+            if (Matrix* m = find(args[1])) {
+                reportFactorization(*m);
+            }
+        } else if (command == "lusolve" || command == "inverse") {
+            bool isSolve = command == "lusolve";
+            if (!expectArgs(args, isSolve ? 4 : 3, isSolve ? 4 : 3, isSolve ? "lusolve DEST A B" : "inverse DEST A")) {
+                return;
+            }
+            Matrix* a = find(args[2]);
+            Matrix* b = a && isSolve ? find(args[3]) : nullptr;
+            if (!a || (isSolve && !b)) {
+                return;
+            }
+            std::shared_ptr<const LUFactorization> lu = a->factorization();
+            Matrix result = isSolve ? lu->solve(*b) : lu->inverse();
+            if (result.isEmpty()) {
+                fail("Matrix " + args[2] + " is singular or the dimensions do not match.");
+                return;
+            }
+            result.setName(args[1]);
+            store(args[1], std::move(result));
+        } else if (command == "verbosity") {
+            size_t level;
+            if (!expectArgs(args, 2, 2, "verbosity 0|1|2")) {
+                return;
+            }
+            if (!parseIndex(args[1], level) || level > 2) {
+                fail("Verbosity must be 0, 1 or 2.");
+                return;
+            }
+            Matrix::setVerbosity(static_cast<Verbosity>(level));
+        } else if (command == "eval") {
+            if (args.size() < 4) {
+                fail("Usage: eval DEST = EXPR");
+                return;
+            }
+            std::string statement, dest, error;
+            for (size_t i = 1; i < args.size(); ++i) {
+                statement += args[i] + " ";
+            }
+            if (!expr::assign(statement, matrices, dest, error)) {
+                fail(error);
+                return;
+            }
+            sparseMatrices.erase(dest);
+        } else if (command == "exactsolve") {
+            if (!expectArgs(args, 2, 2, "exactsolve NAME")) {
+                return;
+            }
+            if (Matrix* m = find(args[1])) {
+                solveExactly(*m);
+            }
+        } else if (command == "sparsify") {
+            if (!expectArgs(args, 2, 2, "sparsify NAME")) {
+                return;
+            }
+            if (Matrix* m = find(args[1])) {
+                store(args[1], SparseMatrix::fromDense(*m));
+            }
+        } else if (command == "densify") {
+            if (!expectArgs(args, 2, 2, "densify NAME")) {
+                return;
+            }
+            auto it = sparseMatrices.find(args[1]);
+            if (it == sparseMatrices.end()) {
+                fail("Sparse matrix with name " + args[1] + " does not exist.");
+                return;
+            }
+            store(args[1], it->second.toDense());
+        } else if (command == "stats") {
+            if (!expectArgs(args, 1, 3, "stats [on|off|reset|json [FILE]]")) {
+                return;
+            }
+            std::string error;
+            if (!runStatsCommand(args.size() > 1 ? args[1] : "", args.size() > 2 ? args[2] : "",
+                                 matrices, sparseMatrices, error)) {
+                fail(error);
+            }
+        } else if (command == "tiled") {
+            std::string error;
+            if (!runTiledCommand(std::vector<std::string>(args.begin() + 1, args.end()), matrices, sparseMatrices, error)) {
+                fail(error);
+            }
+        } else if (command == "importsparse") {
+            if (!expectArgs(args, 3, 3, "importsparse NAME FILE")) {
+                return;
+            }
+            SparseMatrix imported = importSparseMatrix(args[2], args[1]);
+            if (imported.isEmpty()) {
+                fail("Could not import " + args[2] + ".");
+                return;
+            }
+            store(args[1], std::move(imported));
+        } else {
+            fail("Unknown command " + command + ".");
+        }
+    }
+
+    // add/multiply where at least one operand is sparse
+    void combineSparse(bool isAdd, const std::string& dest, const std::string& nameA, const std::string& nameB) {
+        auto sa = sparseMatrices.find(nameA);
+        auto sb = sparseMatrices.find(nameB);
+        if (sa != sparseMatrices.end() && sb != sparseMatrices.end()) {
+            SparseMatrix result = isAdd ? sa->second.add(sb->second) : sa->second.multiply(sb->second);
+            if (result.isEmpty()) {
+                fail("Dimension mismatch.");
+                return;
+            }
+            result.setName(dest);
+            store(dest, std::move(result));
+            return;
+        }
+        Matrix* dense = find(sa != sparseMatrices.end() ? nameB : nameA);
+        if (!dense) {
+            return;
+        }
+        Matrix result;
+        if (sa != sparseMatrices.end()) {
+            result = isAdd ? sa->second.add(*dense) : sa->second.multiply(*dense);
+        } else {
+            result = isAdd ? sb->second.add(*dense) : multiplyDenseSparse(*dense, sb->second);
+        }
+        if (result.isEmpty()) {
+            fail("Dimension mismatch.");
+            return;
+        }
+        result.setName(dest);
+        store(dest, std::move(result));
+    }
+
+    void loadRows(Matrix& m) {
+        FloatView target = m.view();
+        std::string line;
+        for (size_t r = 0; r < target.rows; ++r) {
+            if (!nextLine(line)) {
+                fail("Expected " + std::to_string(target.rows) + " rows for matrix " + m.getName() + ".");
+                return;
+            }
+            size_t count;
+            std::pair<const char*, const char*> badToken;
+            RowParse status = parseRow(line.data(), line.data() + line.size(), false, &target(r, 0), target.columns, count, badToken);
+            if (status == RowParse::InvalidNumber) {
+                fail("Invalid number " + std::string(badToken.first, badToken.second) + ".");
+                return;
+            }
+            if (status != RowParse::Ok) {
+                fail("Expected " + std::to_string(target.columns) + " elements in row " + std::to_string(r + 1) + ".");
+                return;
+            }
+        }
+    }
+};
+
+// Server mode
+//
+// --serve PATH keeps one workspace of named matrices resident and serves it
+// over a Unix domain socket, so jobs skip startup and reloading their data,
+// and factorizations cached by one request are reused by the next.
+//
+// A request is a batch of script commands (see Batch mode), inline load rows
+// included, ended by a blank line. The reply is one line of JSON
+//     {"ok": true, "errors": 0, "output_bytes": 42}
+// followed by exactly output_bytes bytes of whatever the commands printed,
+// error messages included. Line numbers in errors count from the start of
+// the request. A request of just "shutdown" stops the server. A client whose
+// unfinished request grows past kMaxRequestBytes gets an error reply and is
+// disconnected.
+//
+// One poll() loop serves every client. Requests run one at a time, so each
+// sees a consistent workspace, and all the requests that arrive in one wakeup
+// run back to back before any reply is written, which batches small requests
+// from many clients into one pass. Heavy commands still spread over the
+// thread pool. Verbosity is shared by all clients.
+class MatrixServer {
+public:
+    MatrixServer(std::map<std::string, Matrix>& matrices, std::map<std::string, SparseMatrix>& sparseMatrices)
+        : matrices(matrices), sparseMatrices(sparseMatrices) {}
+
+    // Serve until shutdown, SIGINT or SIGTERM. Returns false if the socket
+    // could not be set up.
+    bool run(const std::string& path);
+
+private:
+    std::map<std::string, Matrix>& matrices;
+    std::map<std::string, SparseMatrix>& sparseMatrices;
+
+    struct Client {
+        int fd;
+        std::string input;
+        std::string output;
+        size_t scanned = 0;   // input before this offset holds no blank line
+        bool finished = false; // Peer closed its end or the connection failed
+    };
+
+    static constexpr size_t kMaxRequestBytes = size_t(1) << 28; // 256 MiB
+
+    static inline volatile std::sig_atomic_t stopRequested = 0;
+
+    // Split the next complete request, everything before a blank line, off
+    // the front of the client's input
+    static bool nextRequest(Client& client, std::string& request) {
+        size_t lineStart = client.scanned;
+        while (true) {
+            size_t newline = client.input.find('\n', lineStart);
+            if (newline == std::string::npos) {
+                client.scanned = lineStart;
+                return false;
+            }
+            if (client.input.find_first_not_of(" \t\r", lineStart) >= newline) {
+                request = client.input.substr(0, lineStart);
+                client.input.erase(0, newline + 1);
+                client.scanned = 0;
+                return true;
+            }
+            lineStart = newline + 1;
+        }
+    }
+
+    // Run one request with std::cout and std::cerr captured, and frame the reply
+    std::string execute(const std::string& request, bool& stop) {
+        size_t first = request.find_first_not_of(" \t\r\n");
+        size_t last = request.find_last_not_of(" \t\r\n");
+        if (first != std::string::npos && request.compare(first, last - first + 1, "shutdown") == 0) {
+            stop = true;
+            return "{\"ok\": true, \"errors\": 0, \"output_bytes\": 0}\n";
         }
+        std::istringstream in(request);
+        std::ostringstream captured;
+        std::cout.flush();
+        std::streambuf* previousOut = std::cout.rdbuf(captured.rdbuf());
+        std::streambuf* previousErr = std::cerr.rdbuf(captured.rdbuf());
+        size_t errors = ScriptRunner(in, matrices, sparseMatrices).run();
+        std::cout.rdbuf(previousOut);
+        std::cerr.rdbuf(previousErr);
 
-        // Normalize the pivot row
-        float pivot = array[r][lead];
-        multiplyRow(1.0f / pivot, r);
+        return reply(errors, captured.str());
+    }
 
-        // Eliminate the column above and below the pivot
-        for (size_t i = 0; i < rows; ++i) {
-            if (i != r) {
-                float factor = array[i][lead];
-                addRows(-factor, i, r);
+    static std::string reply(size_t errors, const std::string& output) {
+        return "{\"ok\": " + std::string(errors == 0 ? "true" : "false") + ", \"errors\": " + std::to_string(errors) +
+               ", \"output_bytes\": " + std::to_string(output.size()) + "}\n" + output;
+    }
+
+    // Non-blocking socket I/O. writeTo returns false once the peer is gone.
+    static void readFrom(Client& client);
+    static bool writeTo(Client& client);
+    static bool setNonBlocking(int fd);
+};
+
+#if MATRIX_HAVE_UNIX_SOCKETS
+// Read whatever has arrived without blocking, stopping once the input is
+// over the request limit
+void MatrixServer::readFrom(Client& client) {
+    char buffer[65536];
+    while (client.input.size() <= kMaxRequestBytes) {
+        ssize_t got = ::read(client.fd, buffer, sizeof(buffer));
+        if (got > 0) {
+            client.input.append(buffer, static_cast<size_t>(got));
+        } else if (got < 0 && errno == EINTR) {
+            continue;
+        } else {
+            if (got == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+                client.finished = true;
             }
+            return;
         }
-
-        ++lead; // Move to the next column
     }
 }
 
-Matrix Matrix::transpose() const {
-    Matrix transposedMatrix(name, columns, rows);
-
-    for (size_t r = 0; r < rows; ++r) {
-        for (size_t c = 0; c < columns; ++c) {
-            transposedMatrix.setElement(c, r, array[r][c]);
+// Write as much of the pending reply as the socket takes
+bool MatrixServer::writeTo(Client& client) {
+    size_t sent = 0;
+    while (sent < client.output.size()) {
+        ssize_t put = ::write(client.fd, client.output.data() + sent, client.output.size() - sent);
+        if (put > 0) {
+            sent += static_cast<size_t>(put);
+        } else if (put < 0 && errno == EINTR) {
+            continue;
+        } else {
+            client.output.erase(0, sent);
+            return put < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
         }
     }
+    client.output.clear();
+    return true;
+}
 
-    return transposedMatrix;
+bool MatrixServer::setNonBlocking(int fd) {
+    int flags = ::fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && ::fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
 }
 
-Matrix Matrix::add(const Matrix& other) const {
-    if (rows != other.rows || columns != other.columns) {
-        std::cerr << "Error: Matrices must have the same dimensions to be added.\n";
-        return Matrix(); // Return an empty matrix
+bool MatrixServer::run(const std::string& path) {
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+        std::cerr << "Error: Socket path " << path << " is empty or too long.\n";
+        return false;
     }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
 
-    Matrix result(name, rows, columns);
-
-    for (size_t i = 0; i < rows; ++i) {
-        for (size_t j = 0; j < columns; ++j) {
-            result.setElement(i, j, array[i][j] + other.getElement(i, j));
+    // Replace a socket left behind by an earlier server, but nothing else
+    struct stat existing;
+    if (::stat(path.c_str(), &existing) == 0 && S_ISSOCK(existing.st_mode)) {
+        ::unlink(path.c_str());
+    }
+    int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0 || ::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        ::listen(listener, SOMAXCONN) != 0 || !setNonBlocking(listener)) {
+        std::cerr << "Error: Could not listen on " << path << ": " << std::strerror(errno) << ".\n";
+        if (listener >= 0) {
+            ::close(listener);
         }
+        return false;
     }
 
+    // Replies to vanished clients must not kill the server; SIGINT and
+    // SIGTERM interrupt poll() and end the loop
+    std::signal(SIGPIPE, SIG_IGN);
+    struct sigaction onStop = {};
+    onStop.sa_handler = [](int) { stopRequested = 1; };
+    sigemptyset(&onStop.sa_mask);
+    ::sigaction(SIGINT, &onStop, nullptr);
+    ::sigaction(SIGTERM, &onStop, nullptr);
+    stopRequested = 0;
+    std::cerr << "Serving on " << path << ".\n";
 
-    return result;
-}
-
-bool Matrix::isEmpty() const {
-    return rows == 0 || columns == 0;
-}
+    std::deque<Client> clients;
+    std::vector<pollfd> polled;
+    bool stop = false;
+    while (!stop && !stopRequested) {
+        polled.assign(1, {listener, POLLIN, 0});
+        for (const Client& client : clients) {
+            // A finished client has nothing more to read, and its end of file
+            // would keep POLLIN set; wait only for room to write its reply
+            short events = client.finished ? POLLOUT : client.output.empty() ? POLLIN : POLLIN | POLLOUT;
+            polled.push_back({client.fd, events, 0});
+        }
+        if (::poll(polled.data(), polled.size(), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "Error: poll failed: " << std::strerror(errno) << ".\n";
+            break;
+        }
 
-Matrix Matrix::multiply(const Matrix& other) const {
-    if (columns != other.rows) {
-        std::cerr << "Error: Number of columns in the first matrix must be equal to the number of rows in the second matrix.\n";
-        return Matrix(); // Return an empty matrix
-    }
+        for (size_t i = 0; i < clients.size(); ++i) {
+            if (!clients[i].finished && (polled[i + 1].revents & (POLLIN | POLLHUP | POLLERR))) {
+                readFrom(clients[i]);
+                if (clients[i].finished && clients[i].input.find_first_not_of(" \t\r\n") != std::string::npos) {
+                    // A last request cut off by the client closing its end still runs
+                    clients[i].input += "\n\n";
+                }
+            }
+        }
+        if (polled[0].revents & POLLIN) {
+            int fd;
+            while ((fd = ::accept(listener, nullptr, nullptr)) >= 0) {
+                if (setNonBlocking(fd)) {
+                    clients.push_back({fd, "", "", 0, false});
+                } else {
+                    ::close(fd);
+                }
+            }
+        }
 
-    Matrix result(name, rows, other.columns);
+        // Run every complete request before writing any reply
+        std::string request;
+        for (Client& client : clients) {
+            while (!stop && nextRequest(client, request)) {
+                if (request.find_first_not_of(" \t\r\n") != std::string::npos) {
+                    client.output += execute(request, stop);
+                }
+            }
+            if (client.input.size() > kMaxRequestBytes) {
+                client.output += reply(1, "Error: Request is longer than " + std::to_string(kMaxRequestBytes) +
+                                              " bytes without a blank line.\n");
+                client.input.clear();
+                client.scanned = 0;
+                client.finished = true;
+            }
+        }
 
-    for (size_t i = 0; i < rows; ++i) {
-        for (size_t j = 0; j < other.columns; ++j) {
-            float sum = 0.0f;
-            for (size_t k = 0; k < columns; ++k) {
-                sum += array[i][k] * other.getElement(k, j);
+        for (Client& client : clients) {
+            if (!client.output.empty() && !writeTo(client)) {
+                client.finished = true;
+                client.output.clear();
+            }
+        }
+        for (size_t i = clients.size(); i-- > 0;) {
+            if (clients[i].finished && clients[i].output.empty()) {
+                ::close(clients[i].fd);
+                clients.erase(clients.begin() + static_cast<ptrdiff_t>(i));
             }
-            result.setElement(i, j, sum);
         }
     }
 
-    return result;
+    // Let the last replies out before closing
+    for (Client& client : clients) {
+        if (!client.output.empty()) {
+            ::fcntl(client.fd, F_SETFL, ::fcntl(client.fd, F_GETFL, 0) & ~O_NONBLOCK);
+            writeTo(client);
+        }
+        ::close(client.fd);
+    }
+    ::close(listener);
+    ::unlink(path.c_str());
+    std::cerr << "Server stopped.\n";
+    return true;
 }
+#else
+void MatrixServer::readFrom(Client&) {}
+bool MatrixServer::writeTo(Client&) { return false; }
+bool MatrixServer::setNonBlocking(int) { return false; }
 
-Matrix Matrix::duplicate(const std::string& newName) const {
-    Matrix duplicated(newName, rows, columns);
-    duplicated.array = array;
-    return duplicated;
+bool MatrixServer::run(const std::string& path) {
+    std::cerr << "Error: Server mode needs Unix domain sockets, which this platform lacks (" << path << ").\n";
+    return false;
 }
+#endif
+
+// Programs that embed this file, such as matrix_benchmark.cpp, define
+// MATRIX_NO_MAIN and bring their own
+#ifndef MATRIX_NO_MAIN
+int main(int argc, char* argv[]) {
+    std::string scriptPath;
+    std::string statsJsonPath;
+    std::string servePath;
+    bool statsAtExit = false;
+    int verbosityLevel = -1;
+    if (const char* env = std::getenv("MATRIX_STATS")) {
+        stats::setEnabled(std::strcmp(env, "") != 0 && std::strcmp(env, "0") != 0);
+    }
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--script" && i + 1 < argc) {
+            scriptPath = argv[++i];
+        } else if (arg == "--batch") {
+            scriptPath = "-";
+        } else if (arg == "--serve" && i + 1 < argc) {
+            servePath = argv[++i];
+        } else if (arg == "--verbosity" && i + 1 < argc) {
+            verbosityLevel = std::atoi(argv[++i]);
+            if (verbosityLevel < 0 || verbosityLevel > 2) {
+                std::cerr << "Error: --verbosity expects 0, 1 or 2.\n";
+                return 1;
+            }
+        } else if (arg == "--threads" && i + 1 < argc) {
+            long count = std::strtol(argv[++i], nullptr, 10);
+            if (count > 0) {
+                ThreadPool::setThreadCount(static_cast<size_t>(count));
+            } else {
+                std::cerr << "Error: --threads expects a positive number.\n";
+                return 1;
+            }
+        } else if (arg == "--tile-memory" && i + 1 < argc) {
+            long mebibytes = std::strtol(argv[++i], nullptr, 10);
+            if (mebibytes > 0) {
+                TiledMatrix::setMemoryBudget(static_cast<size_t>(mebibytes));
+            } else {
+                std::cerr << "Error: --tile-memory expects a positive number of MiB.\n";
+                return 1;
+            }
+        } else if (arg == "--stats") {
+            stats::setEnabled(true);
+            statsAtExit = true;
+        } else if (arg == "--stats-json" && i + 1 < argc) {
+            stats::setEnabled(true);
+            statsJsonPath = argv[++i];
+        } else {
+            std::cerr << "Error: Unknown option " << arg << ".\n";
+            std::cerr << "Usage: " << argv[0] << " [--script FILE|-] [--batch] [--verbosity 0|1|2] [--threads N]"
+                      << " [--tile-memory MIB]"
+                      << " [--stats] [--stats-json FILE] [--serve SOCKET]\n";
+            return 1;
+        }
+    }
 
-int main() {
     std::map<std::string, Matrix> matrices;
+    std::map<std::string, SparseMatrix> sparseMatrices;
+
+    // --stats reports to stderr so it never mixes with a script's output
+    auto reportStats = [&]() {
+        if (statsAtExit) {
+            stats::report(std::cerr, holdingsOf(matrices, sparseMatrices));
+        }
+        std::string error;
+        if (!statsJsonPath.empty() && !runStatsCommand("json", statsJsonPath, matrices, sparseMatrices, error)) {
+            std::cerr << "Error: " << error << "\n";
+        }
+    };
+
+    if (!servePath.empty()) {
+        // Like scripts, requests run silently unless asked otherwise
+        Matrix::setVerbosity(verbosityLevel >= 0 ? static_cast<Verbosity>(verbosityLevel) : Verbosity::Silent);
+        bool served = MatrixServer(matrices, sparseMatrices).run(servePath);
+        reportStats();
+        return served ? 0 : 1;
+    }
+    if (!scriptPath.empty()) {
+        // Scripts run silently unless asked otherwise
+        Matrix::setVerbosity(verbosityLevel >= 0 ? static_cast<Verbosity>(verbosityLevel) : Verbosity::Silent);
+        size_t errors;
+        if (scriptPath == "-") {
+            errors = ScriptRunner(std::cin, matrices, sparseMatrices).run();
+        } else {
+            std::ifstream file(scriptPath);
+            if (!file) {
+                std::cerr << "Error: Could not open script " << scriptPath << ".\n";
+                return 1;
+            }
+            errors = ScriptRunner(file, matrices, sparseMatrices).run();
+        }
+        reportStats();
+        return errors == 0 ? 0 : 1;
+    }
+    if (verbosityLevel >= 0) {
+        Matrix::setVerbosity(static_cast<Verbosity>(verbosityLevel));
+    }
     bool running = true;
 
     while (running) {
@@ -306,6 +7773,23 @@ int main() {
         std::cout << "9. Add two matrices\n";
         std::cout << "10. Multiply two matrices\n";
         std::cout << "11. Duplicate a matrix\n";
+        std::cout << "12. LU factorize a matrix\n";
+        std::cout << "13. Solve using cached LU factors\n";
+        std::cout << "14. Invert a matrix\n";
+        std::cout << "15. Fast solve (blocked, no step trace)\n";
+        std::cout << "16. Save a matrix to a file\n";
+        std::cout << "17. Load a matrix from a file\n";
+        std::cout << "18. Import a text matrix (CSV, whitespace or .mtx)\n";
+        std::cout << "19. Convert a matrix between dense and sparse\n";
+        std::cout << "20. Evaluate an expression (e.g. C = A*B + D)\n";
+        std::cout << "21. Solve exactly (rational arithmetic)\n";
+        std::cout << "22. Performance statistics\n";
+        std::cout << "23. Undo a row operation\n";
+        std::cout << "24. Redo a row operation\n";
+        std::cout << "25. Replay one matrix's row operations on another\n";
+        std::cout << "26. Iterative solve (CG, GMRES, Jacobi, Gauss-Seidel)\n";
+        std::cout << "27. Out-of-core operation on tiled files\n";
+        std::cout << "28. Export a matrix as CSV or raw float32\n";
         std::cout << "0. Exit\n";
         std::cout << "Enter your choice: ";
         
@@ -324,6 +7808,7 @@ int main() {
                 std::cout << "Enter number of columns: ";
                 std::cin >> cols;
                 std::cin.ignore(); // Consume newline
+                sparseMatrices.erase(name);
                 matrices[name] = Matrix(name, rows, cols);
                 break;
             }
@@ -347,25 +7832,36 @@ int main() {
                 for (const auto& pair : matrices) {
                             std::cout << pair.second.getName() << std::endl;
                         }
+                for (const auto& pair : sparseMatrices) {
+                    std::cout << pair.second.getName() << " (sparse)" << std::endl;
+                }
 
                 std::string name;
                 std::cout << "Enter matrix name to print (or type 'ALL' to print all matrices): ";
                 std::getline(std::cin, name);
 
+                // Asked for by name, so print every entry; the results shown
+                // after other operations stay summarized
                 if (name == "ALL") {
                     // Print all matrices
-                    if (matrices.empty()) {
+                    if (matrices.empty() && sparseMatrices.empty()) {
                         std::cout << "No matrices to display.\n";
                     } else {
                         for (const auto& pair : matrices) {
-                            pair.second.print();
+                            pair.second.print(true);
+                            std::cout << std::endl;
+                        }
+                        for (const auto& pair : sparseMatrices) {
+                            pair.second.print(true);
                             std::cout << std::endl;
                         }
                     }
                 } else {
                     // Print a specific matrix
                     if (matrices.find(name) != matrices.end()) {
-                        matrices[name].print();
+                        matrices[name].print(true);
+                    } else if (sparseMatrices.find(name) != sparseMatrices.end()) {
+                        sparseMatrices[name].print(true);
                     } else {
                         std::cerr << "Error: Matrix with name " << name << " does not exist.\n";
                     }
@@ -464,7 +7960,7 @@ int main() {
 
                 std::getline(std::cin, name);
                 if (matrices.find(name) != matrices.end()) {
-                    matrices[name] = matrices[name].transpose();
+                    matrices[name].transposeInPlace();
                     std::cout << "Transposed Matrix:\n";
                     matrices[name].print();
                 } else {
@@ -491,7 +7987,7 @@ int main() {
                     if(sum.isEmpty()) {
                         break;
                     }
-                    matrices[name1] = matrices[name1].add(matrices[name2]);
+                    matrices[name1] = std::move(sum);
                     std::cout << "Matrix Sum:\n";
                     matrices[name1].print();
                 } else {
@@ -518,7 +8014,7 @@ int main() {
                     if(product.isEmpty()) {
                         break;
                     }
-                    matrices[name1] = matrices[name1].multiply(matrices[name2]);
+                    matrices[name1] = std::move(product);
                     std::cout << "Matrix Product:\n";
                     matrices[name1].print();
                 } else {
@@ -537,9 +8033,339 @@ int main() {
                 std::cout << "Enter the name of the new matrix:\n";
                 std::getline(std::cin, name2);
 
+                sparseMatrices.erase(name2);
                 matrices[name2] = matrices[name1].duplicate(name2);
                 break;
             }
+            case 12: {
+                std::string name;
+                std::cout << "Enter matrix name:\n";
+                for (const auto& pair : matrices) {
+                    std::cout << pair.second.getName() << std::endl;
+                }
+                std::getline(std::cin, name);
+                if (matrices.find(name) != matrices.end()) {
+                    reportFactorization(matrices[name]);
+                } else {
+                    std::cerr << "Error: Matrix with name " << name << " does not exist.\n";
+                }
+                break;
+            }
+            case 13: {
+                std::string name1, name2, name3;
+                std::cout << "Enter the name of the coefficient matrix:\n";
+                for (const auto& pair : matrices) {
+                    std::cout << pair.second.getName() << std::endl;
+                }
+                std::getline(std::cin, name1);
+
+                std::cout << "Enter the name of the right-hand side matrix:\n";
+                std::getline(std::cin, name2);
+
+                std::cout << "Enter the name of the solution matrix:\n";
+                std::getline(std::cin, name3);
+
+                if (matrices.find(name1) != matrices.end() && matrices.find(name2) != matrices.end()) {
+                    Matrix solution = matrices[name1].factorization()->solve(matrices[name2]);
+                    if (solution.isEmpty()) {
+                        std::cerr << "Error: Matrix " << name1 << " is singular or the dimensions do not match.\n";
+                        break;
+                    }
+                    solution.setName(name3);
+                    sparseMatrices.erase(name3);
+                    matrices[name3] = std::move(solution);
+                    std::cout << "Solution:\n";
+                    matrices[name3].print();
+                } else {
+                    std::cerr << "Error: One or both matrices do not exist.\n";
+                }
+                break;
+            }
+            case 14: {
+                std::string name1, name2;
+                std::cout << "Enter the name of the matrix to invert:\n";
+                for (const auto& pair : matrices) {
+                    std::cout << pair.second.getName() << std::endl;
+                }
+                std::getline(std::cin, name1);
+
+                std::cout << "Enter the name of the new matrix:\n";
+                std::getline(std::cin, name2);
+
+                if (matrices.find(name1) != matrices.end()) {
+                    Matrix inverse = matrices[name1].factorization()->inverse();
+                    if (inverse.isEmpty()) {
+                        std::cerr << "Error: Matrix " << name1 << " is singular.\n";
+                        break;
+                    }
+                    inverse.setName(name2);
+                    sparseMatrices.erase(name2);
+                    matrices[name2] = std::move(inverse);
+                    std::cout << "Inverse:\n";
+                    matrices[name2].print();
+                } else {
+                    std::cerr << "Error: Matrix with name " << name1 << " does not exist.\n";
+                }
+                break;
+            }
+            case 15: {
+                std::string name;
+                std::cout << "Enter matrix name:\n";
+                for (const auto& pair : matrices) {
+                    std::cout << pair.second.getName() << std::endl;
+                }
+                for (const auto& pair : sparseMatrices) {
+                    std::cout << pair.second.getName() << " (sparse)" << std::endl;
+                }
+                std::getline(std::cin, name);
+                if (matrices.find(name) != matrices.end()) {
+                    reportSolutionKind(name, matrices[name].fastSolve());
+                    matrices[name].print();
+                } else if (sparseMatrices.find(name) != sparseMatrices.end()) {
+                    reportSolutionKind(name, sparseMatrices[name].solve());
+                    sparseMatrices[name].print();
+                } else {
+                    std::cerr << "Error: Matrix with name " << name << " does not exist.\n";
+                }
+                break;
+            }
+            case 16: {
+                std::string name, path;
+                std::cout << "Enter the name of the matrix to save:\n";
+                for (const auto& pair : matrices) {
+                    std::cout << pair.second.getName() << std::endl;
+                }
+                std::getline(std::cin, name);
+
+                std::cout << "Enter the file path: ";
+                std::getline(std::cin, path);
+
+                if (matrices.find(name) != matrices.end()) {
+                    if (matrices[name].save(path)) {
+                        std::cout << "Saved matrix " << name << " to " << path << ".\n";
+                    }
+                } else {
+                    std::cerr << "Error: Matrix with name " << name << " does not exist.\n";
+                }
+                break;
+            }
+            case 17: {
+                std::string name, path;
+                std::cout << "Enter the file path: ";
+                std::getline(std::cin, path);
+
+                std::cout << "Enter the name of the new matrix:\n";
+                std::getline(std::cin, name);
+
+                Matrix loaded = Matrix::load(path, name);
+                if (!loaded.isEmpty()) {
+                    sparseMatrices.erase(name);
+                    matrices[name] = std::move(loaded);
+                    std::cout << "Loaded matrix " << name << ":\n";
+                    matrices[name].print();
+                }
+                break;
+            }
+            case 18: {
+                std::string name, path;
+                std::cout << "Enter the file path: ";
+                std::getline(std::cin, path);
+
+                std::cout << "Enter the name of the new matrix:\n";
+                std::getline(std::cin, name);
+
+                Matrix imported = importTextMatrix(path, name);
+                if (!imported.isEmpty()) {
+                    sparseMatrices.erase(name);
+                    matrices[name] = std::move(imported);
+                    std::cout << "Imported matrix " << name << ":\n";
+                    matrices[name].print();
+                }
+                break;
+            }
+            case 19: {
+                std::string name;
+                std::cout << "Enter matrix name:\n";
+                for (const auto& pair : matrices) {
+                    std::cout << pair.second.getName() << std::endl;
+                }
+                for (const auto& pair : sparseMatrices) {
+                    std::cout << pair.second.getName() << " (sparse)" << std::endl;
+                }
+                std::getline(std::cin, name);
+                if (matrices.find(name) != matrices.end()) {
+                    sparseMatrices[name] = SparseMatrix::fromDense(matrices[name]);
+                    matrices.erase(name);
+                    std::cout << "Matrix " << name << " is now sparse (density " << sparseMatrices[name].density() << ").\n";
+                } else if (sparseMatrices.find(name) != sparseMatrices.end()) {
+                    matrices[name] = sparseMatrices[name].toDense();
+                    sparseMatrices.erase(name);
+                    std::cout << "Matrix " << name << " is now dense.\n";
+                } else {
+                    std::cerr << "Error: Matrix with name " << name << " does not exist.\n";
+                }
+                break;
+            }
+            case 20: {
+                std::string statement, dest, error;
+                for (const auto& pair : matrices) {
+                    std::cout << pair.second.getName() << std::endl;
+                }
+                std::cout << "Enter an expression such as C = A*B + 2*D or A = A' * A:\n";
+                std::getline(std::cin, statement);
+                if (expr::assign(statement, matrices, dest, error)) {
+                    sparseMatrices.erase(dest);
+                    matrices[dest].print();
+                } else {
+                    std::cerr << "Error: " << error << "\n";
+                }
+                break;
+            }
+            case 21: {
+                std::string name;
+                std::cout << "Enter matrix name:\n";
+                for (const auto& pair : matrices) {
+                    std::cout << pair.second.getName() << std::endl;
+                }
+                std::getline(std::cin, name);
+                if (matrices.find(name) != matrices.end()) {
+                    solveExactly(matrices[name]);
+                } else {
+                    std::cerr << "Error: Matrix with name " << name << " does not exist.\n";
+                }
+                break;
+            }
+            case 22: {
+                std::string line, action, path, error;
+                stats::report(std::cout, holdingsOf(matrices, sparseMatrices));
+                std::cout << "Enter on, off, reset, json [FILE], or nothing to return: ";
+                std::getline(std::cin, line);
+                std::istringstream iss(line);
+                iss >> action >> path;
+                if (!action.empty() && !runStatsCommand(action, path, matrices, sparseMatrices, error)) {
+                    std::cerr << "Error: " << error << "\n";
+                }
+                break;
+            }
+            case 23:
+            case 24: {
+                std::string name;
+                std::cout << "Enter matrix name:\n";
+                for (const auto& pair : matrices) {
+                    std::cout << pair.second.getName() << std::endl;
+                }
+                std::getline(std::cin, name);
+                if (matrices.find(name) == matrices.end()) {
+                    std::cerr << "Error: Matrix with name " << name << " does not exist.\n";
+                } else if (!(choice == 23 ? matrices[name].undo() : matrices[name].redo())) {
+                    std::cerr << "Error: Nothing to " << (choice == 23 ? "undo" : "redo") << " for matrix " << name << ".\n";
+                }
+                break;
+            }
+            case 25: {
+                std::string source, target;
+                for (const auto& pair : matrices) {
+                    std::cout << pair.second.getName() << " (" << pair.second.journal().size() << " row operations)" << std::endl;
+                }
+                std::cout << "Enter the matrix whose row operations to replay: ";
+                std::getline(std::cin, source);
+                std::cout << "Enter the matrix to apply them to: ";
+                std::getline(std::cin, target);
+                if (matrices.find(source) == matrices.end()) {
+                    std::cerr << "Error: Matrix with name " << source << " does not exist.\n";
+                } else if (matrices.find(target) == matrices.end()) {
+                    std::cerr << "Error: Matrix with name " << target << " does not exist.\n";
+                } else {
+                    matrices[target].replay(matrices[source].journal());
+                }
+                break;
+            }
+            case 26: {
+                std::string name, method, preconditioner, toleranceStr, dest;
+                std::cout << "Enter the name of the augmented system:\n";
+                for (const auto& pair : matrices) {
+                    std::cout << pair.second.getName() << std::endl;
+                }
+                for (const auto& pair : sparseMatrices) {
+                    std::cout << pair.second.getName() << " (sparse)" << std::endl;
+                }
+                std::getline(std::cin, name);
+                bool isSparse = sparseMatrices.find(name) != sparseMatrices.end();
+                if (!isSparse && matrices.find(name) == matrices.end()) {
+                    std::cerr << "Error: Matrix with name " << name << " does not exist.\n";
+                    break;
+                }
+                iterative::Options options;
+                std::cout << "Enter the method (cg, gmres, jacobi or gaussseidel): ";
+                std::getline(std::cin, method);
+                if (!iterative::parseMethod(method, options.method)) {
+                    std::cerr << "Error: Unknown method " << method << ".\n";
+                    break;
+                }
+                std::cout << "Enter the preconditioner (none, jacobi or ilu0): ";
+                std::getline(std::cin, preconditioner);
+                if (!iterative::parsePreconditioner(preconditioner, options.preconditioner)) {
+                    std::cerr << "Error: Unknown preconditioner " << preconditioner << ".\n";
+                    break;
+                }
+                std::cout << "Enter the relative tolerance (e.g. 1e-6): ";
+                std::getline(std::cin, toleranceStr);
+                float tolerance = Matrix().parseFraction(toleranceStr);
+                if (!(tolerance > 0.0f)) {
+                    std::cerr << "Error: The tolerance must be positive.\n";
+                    break;
+                }
+                options.tolerance = tolerance;
+                std::cout << "Enter the name for the solution: ";
+                std::getline(std::cin, dest);
+
+                bool converged;
+                Matrix x = isSparse ? solveIteratively(iterative::System(sparseMatrices[name]), options, dest, converged)
+                                    : solveIteratively(iterative::System(std::as_const(matrices[name]).view()), options, dest, converged);
+                if (!x.isEmpty()) {
+                    sparseMatrices.erase(dest);
+                    matrices[dest] = std::move(x);
+                    matrices[dest].print();
+                }
+                break;
+            }
+            case 27: {
+                std::string line, token, error;
+                std::cout << "Enter save NAME FILE [TILE], load NAME FILE, add OUT A B, multiply OUT A B,\n"
+                          << "transpose OUT A, solve OUT A B, memory MIB, or nothing to return: ";
+                std::getline(std::cin, line);
+                std::istringstream iss(line);
+                std::vector<std::string> args;
+                while (iss >> token) {
+                    args.push_back(token);
+                }
+                if (!args.empty() && !runTiledCommand(args, matrices, sparseMatrices, error)) {
+                    std::cerr << "Error: " << error << "\n";
+                }
+                break;
+            }
+            case 28: {
+                std::string name, path, format;
+                std::cout << "Enter the name of the matrix to export:\n";
+                for (const auto& pair : matrices) {
+                    std::cout << pair.second.getName() << std::endl;
+                }
+                std::getline(std::cin, name);
+
+                std::cout << "Enter the file path: ";
+                std::getline(std::cin, path);
+                std::cout << "Enter the format (csv or raw): ";
+                std::getline(std::cin, format);
+
+                if (matrices.find(name) == matrices.end()) {
+                    std::cerr << "Error: Matrix with name " << name << " does not exist.\n";
+                } else if (format != "csv" && format != "raw") {
+                    std::cerr << "Error: Unknown format " << format << "; expected csv or raw.\n";
+                } else if (format == "csv" ? matrices[name].exportCsv(path) : matrices[name].exportRaw(path)) {
+                    std::cout << "Exported matrix " << name << " to " << path << ".\n";
+                }
+                break;
+            }
             case 0: {
                 running = false;
                 break;
@@ -549,5 +8375,7 @@ int main() {
                 
         }
     }
+    reportStats();
     return 0;
-}
\ No newline at end of file
+}
+#endif // MATRIX_NO_MAIN